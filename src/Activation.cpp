@@ -0,0 +1,101 @@
+#include "Activation.h"
+#include "Kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+const char* activationName(Activation activation) {
+
+	switch (activation) {
+	case Tanh: return "tanh";
+	case ReLU: return "ReLU";
+	case LeakyReLU: return "leaky ReLU";
+	case FastSigmoid: return "fast sigmoid";
+	default: return "sigmoid";
+	}
+}
+
+// table of the sigmoid on [-fastRange ; fastRange], linearly interpolated
+// the interpolation error is below step^2 / 8 * max|sigmoid''| = 7.4E-7, and outside the range the
+// constants 0 and 1 are off by less than exp(-16) = 1.1E-7 : hence fastSigmoidMaxError
+static const double fastRange = 16;
+static const int fastSteps = 4096;
+
+template<typename T>
+static const std::vector<T>& fastSigmoidTable() {
+
+	static std::vector<T> table = []() {
+		std::vector<T> t(fastSteps + 2); // (one more, so that the last interval can be interpolated)
+		for (int i = 0; i < t.size(); i++) {
+			double x = -fastRange + i * 2 * fastRange / fastSteps;
+			t[i] = T(1 / (1 + exp(-x)));
+		}
+		return t;
+	}();
+	return table;
+}
+
+template<typename T>
+static void fastSigmoid(const T* input, T* value, int n) {
+
+	const std::vector<T>& table = fastSigmoidTable<T>();
+	const T scale = T(fastSteps / (2 * fastRange));
+	for (int i = 0; i < n; i++) {
+		T x = (input[i] + T(fastRange)) * scale; // position in the table
+		if (!(x > 0)) { x = 0; } // (NaN too : int(NaN) would be undefined)
+		if (x > T(fastSteps)) { x = T(fastSteps); }
+		int k = int(x);
+		T w = x - k;
+		value[i] = input[i] == input[i] ? table[k] + w * (table[k + 1] - table[k]) : input[i]; // NaN stays NaN, as with exp
+	}
+}
+
+template<typename T>
+void applyActivation(Activation activation, const T* input, T* value, int n) {
+
+	switch (activation) {
+	case Sigmoid:
+		Kernels::sigmoid(input, value, n);
+		break;
+	case Tanh:
+		for (int i = 0; i < n; i++) { value[i] = 2 * input[i]; }
+		Kernels::sigmoid(value, value, n);
+		for (int i = 0; i < n; i++) { value[i] = 2 * value[i] - 1; }
+		break;
+	case ReLU:
+		for (int i = 0; i < n; i++) { value[i] = input[i] > 0 ? input[i] : T(0); }
+		break;
+	case LeakyReLU:
+		for (int i = 0; i < n; i++) { value[i] = input[i] > 0 ? input[i] : T(leakySlope) * input[i]; }
+		break;
+	case FastSigmoid:
+		fastSigmoid(input, value, n);
+		break;
+	}
+}
+
+template<typename T>
+void multiplyDerivative(Activation activation, const T* value, T* diff, int n) {
+
+	switch (activation) {
+	case Sigmoid:
+	case FastSigmoid:
+		for (int i = 0; i < n; i++) { diff[i] *= value[i] * (1 - value[i]); }
+		break;
+	case Tanh:
+		for (int i = 0; i < n; i++) { diff[i] *= 1 - value[i] * value[i]; }
+		break;
+	case ReLU:
+		for (int i = 0; i < n; i++) { diff[i] = value[i] > 0 ? diff[i] : T(0); }
+		break;
+	case LeakyReLU: // (the values have the sign of the inputs)
+		for (int i = 0; i < n; i++) { diff[i] = value[i] > 0 ? diff[i] : T(leakySlope) * diff[i]; }
+		break;
+	}
+}
+
+template void applyActivation<double>(Activation, const double*, double*, int);
+template void applyActivation<float>(Activation, const float*, float*, int);
+template void multiplyDerivative<double>(Activation, const double*, double*, int);
+template void multiplyDerivative<float>(Activation, const float*, float*, int);
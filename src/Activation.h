@@ -0,0 +1,24 @@
+#pragma once
+
+// activation functions of the neurons, applied to whole rows of a layer
+// the derivatives are computed from the cached values f(x), never from the inputs x
+enum Activation {
+	Sigmoid, // 1 / (1 + exp(-x)), vectorized with Kernels::sigmoid
+	Tanh, // = 2 * sigmoid(2x) - 1
+	ReLU, // max(0, x)
+	LeakyReLU, // x if x > 0, else leakySlope * x
+	FastSigmoid // sigmoid interpolated in a table : absolute error below 1E-6 (see fastSigmoidMaxError)
+};
+
+const char* activationName(Activation activation);
+
+const double leakySlope = 0.1;
+const double fastSigmoidMaxError = 1E-6; // bound of | FastSigmoid(x) - Sigmoid(x) | for all x (measured : 7.4E-7 in double, 9.6E-7 in float)
+
+// value[i] = f( input[i] ) (input and value may be the same array)
+template<typename T>
+void applyActivation(Activation activation, const T* input, T* value, int n);
+
+// diff[i] *= f'( input[i] ), from value[i] = f( input[i] )
+template<typename T>
+void multiplyDerivative(Activation activation, const T* value, T* diff, int n);
@@ -0,0 +1,153 @@
+#include "BatchLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+template<typename T>
+BatchLoader<T>::BatchLoader(const Dataset<T>& dataset, int batchSize, int nbBuffers, int threads, unsigned seed) :
+	dataset(dataset), batchSize(std::max(batchSize, 1)), nbBuffers(std::max(nbBuffers, 2)), nbThreads(std::max(threads, 1)),
+	seed(seed), augmented(false), augmentation(), nbBatches(0), current(-1), stopping(false), waiting(0) {
+
+	inputs.resize(this->nbBuffers);
+	outputs.resize(this->nbBuffers);
+	sizes.resize(this->nbBuffers);
+	ready.assign(this->nbBuffers, -1);
+	for (int b = 0; b < this->nbBuffers; b++) {
+		inputs[b].resize(size_t(this->batchSize) * dataset.inputSize());
+		outputs[b].resize(size_t(this->batchSize) * dataset.outputSize());
+	}
+}
+
+template<typename T>
+BatchLoader<T>::~BatchLoader() {
+
+	stop();
+}
+
+template<typename T>
+void BatchLoader<T>::setAugmentation(const Augmentation& augmentation) {
+
+	if (size_t(augmentation.width) * augmentation.height * augmentation.channels != dataset.inputSize()) {
+		throw std::invalid_argument("the augmented image doesn't have the size of the inputs");
+	}
+	this->augmentation = augmentation;
+	augmented = augmentation.maxOffset > 0 || augmentation.flip || augmentation.noise > 0;
+}
+
+template<typename T>
+void BatchLoader<T>::start(int epochs) {
+
+	stop();
+	stopping = false;
+	nbBatches = (long long)std::max(epochs, 0) * batchesPerEpoch();
+	current = -1;
+	waiting = 0;
+	ready.assign(nbBuffers, -1);
+	for (int k = 0; k < nbThreads; k++) { producers.push_back(std::thread(&BatchLoader::produce, this, k)); }
+}
+
+template<typename T>
+void BatchLoader<T>::stop() {
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	released.notify_all();
+	for (std::thread& t : producers) { t.join(); }
+	producers.clear();
+}
+
+template<typename T>
+void BatchLoader<T>::produce(int k) {
+
+	// batch b goes to the buffer b % nbBuffers, once the consumer is done with the batch b - nbBuffers
+	for (long long b = k; b < nbBatches; b += nbThreads) {
+		int buffer = int(b % nbBuffers);
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			released.wait(lock, [&] { return stopping || b - nbBuffers < std::max(current, 0LL); });
+			if (stopping) { return; }
+		}
+		pack(b, buffer);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ready[buffer] = b;
+		}
+		produced.notify_all();
+	}
+}
+
+template<typename T>
+void BatchLoader<T>::pack(long long batch, int buffer) {
+
+	int inputSize = dataset.inputSize(), outputSize = dataset.outputSize();
+	int first = int(batch % batchesPerEpoch()) * batchSize;
+	int size = std::min(batchSize, dataset.size() - first);
+	for (int s = 0; s < size; s++) { // (rows that aren't stored as T are written in place)
+		T* inputRow = inputs[buffer].data() + size_t(s) * inputSize;
+		T* outputRow = outputs[buffer].data() + size_t(s) * outputSize;
+		const T* input = dataset.input(first + s, inputRow);
+		const T* output = dataset.output(first + s, outputRow);
+		if (input != inputRow) { std::copy(input, input + inputSize, inputRow); }
+		if (output != outputRow) { std::copy(output, output + outputSize, outputRow); }
+		if (augmented) { augment(inputRow, unsigned(seed + (batch * batchSize + s) * 2654435761ull)); }
+	}
+	sizes[buffer] = size;
+}
+
+template<typename T>
+void BatchLoader<T>::augment(T* row, unsigned rowSeed) const {
+
+	const Augmentation& a = augmentation;
+	std::minstd_rand random(rowSeed | 1); // (a zero seed would be invalid)
+	int dx = 0, dy = 0;
+	if (a.maxOffset > 0) {
+		std::uniform_int_distribution<int> offset(-a.maxOffset, a.maxOffset);
+		dx = offset(random);
+		dy = offset(random);
+	}
+	bool flip = a.flip && (random() & 1);
+
+	if (dx != 0 || dy != 0 || flip) {
+		int lineSize = a.width * a.channels;
+		std::vector<T> src(row, row + a.height * lineSize);
+		for (int y = 0; y < a.height; y++) {
+			int srcY = y - dy;
+			for (int x = 0; x < a.width; x++) {
+				int srcX = (flip ? a.width - 1 - x : x) - dx;
+				bool inside = srcX >= 0 && srcX < a.width && srcY >= 0 && srcY < a.height;
+				for (int c = 0; c < a.channels; c++) {
+					row[y * lineSize + x * a.channels + c] = inside ? src[srcY * lineSize + srcX * a.channels + c] : T(0);
+				}
+			}
+		}
+	}
+	if (a.noise > 0) {
+		std::normal_distribution<T> noise(0, a.noise);
+		for (int i = 0; i < a.width * a.height * a.channels; i++) { row[i] += noise(random); }
+	}
+}
+
+template<typename T>
+bool BatchLoader<T>::next(Batch& batch) {
+
+	std::unique_lock<std::mutex> lock(mutex);
+	current++; // (releases the previous batch)
+	released.notify_all();
+	if (current >= nbBatches) { return false; }
+
+	int buffer = int(current % nbBuffers);
+	if (ready[buffer] != current) {
+		auto start = std::chrono::steady_clock::now();
+		produced.wait(lock, [&] { return ready[buffer] == current; });
+		waiting += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	batch = { inputs[buffer].data(), outputs[buffer].data(), sizes[buffer] };
+	return true;
+}
+
+template class BatchLoader<double>;
+template class BatchLoader<float>;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Dataset.h"
+#include "Kernels.h"
+
+// produces the mini-batches of a dataset on background threads, in a ring of buffers, while the previous ones are learnt
+// augmentations are applied to the rows when a batch is packed (the dataset is never modified)
+// batches are always the same for a seed, whatever the nb of threads
+template<typename T>
+class BatchLoader
+{
+public:
+	struct Augmentation {
+		int width, height, channels; // layout of the inputs : a row-major image, with interleaved channels
+		int maxOffset; // random translations of up to maxOffset pixels in x and y (the borders are filled with zeros)
+		bool flip; // random horizontal flips
+		T noise; // standard deviation of a gaussian noise added to the inputs (0 : none)
+	};
+	struct Batch {
+		const T* inputs; // size x inputSize
+		const T* outputs; // size x outputSize
+		int size;
+	};
+
+private:
+	const Dataset<T>& dataset;
+	int batchSize, nbBuffers, nbThreads;
+	unsigned seed;
+	bool augmented;
+	Augmentation augmentation;
+
+	std::vector<AlignedVector<T>> inputs, outputs; // of each buffer
+	std::vector<int> sizes;
+	std::vector<long long> ready; // batch held by each buffer (-1 : none)
+
+	std::vector<std::thread> producers;
+	std::mutex mutex;
+	std::condition_variable produced, released;
+	long long nbBatches; // to produce since start
+	long long current; // batch held by the consumer (-1 : none)
+	bool stopping;
+	double waiting; // in seconds
+
+	void produce(int k); // loop of the producers
+	void pack(long long batch, int buffer);
+	void augment(T* row, unsigned rowSeed) const;
+
+public:
+	// dataset must outlive the loader ; threads : nb of background threads packing batches
+	BatchLoader(const Dataset<T>& dataset, int batchSize, int nbBuffers = 3, int threads = 1, unsigned seed = 0);
+	~BatchLoader();
+	BatchLoader(const BatchLoader&) = delete;
+	BatchLoader& operator=(const BatchLoader&) = delete;
+
+	void setAugmentation(const Augmentation& augmentation); // (for the next start) throws std::invalid_argument if it doesn't match the inputs
+
+	const Dataset<T>& getDataset() const { return dataset; }
+	int getBatchSize() const { return batchSize; }
+	int batchesPerEpoch() const { return (dataset.size() + batchSize - 1) / batchSize; }
+
+	// starts producing the batches of epochs passes on the dataset (in its order), stopping the previous ones
+	void start(int epochs);
+	// gives the next batch, valid until the next call ; waits if it isn't ready, and returns false after the last one
+	bool next(Batch& batch);
+	void stop();
+
+	double waitSeconds() const { return waiting; } // time next spent waiting for batches, since start (0 if the loader kept up)
+};
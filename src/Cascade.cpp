@@ -0,0 +1,225 @@
+#include "Cascade.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+
+template<typename T, typename Acc>
+Cascade<T, Acc>::Cascade(int windowWidth, int windowHeight) :
+	windowWidth(windowWidth), windowHeight(windowHeight), nbRangeStages(0), mutex(new std::mutex()) {}
+
+template<typename T, typename Acc>
+void Cascade<T, Acc>::addRangeStage(double threshold) {
+
+	if (nbRangeStages < stages.size()) { throw std::invalid_argument("the range stages must come before the networks"); }
+	stages.push_back({ "range", NULL, 1, Score(), threshold, { 0, 0, 0 } });
+	nbRangeStages++;
+}
+
+template<typename T, typename Acc>
+void Cascade<T, Acc>::addNetworkStage(const std::string& name, const Network<T, Acc>& net, Score score, int factor, double threshold) {
+
+	if (factor < 1 || windowWidth % factor != 0 || windowHeight % factor != 0) {
+		throw std::invalid_argument("the window can't be downsampled by " + std::to_string(factor));
+	}
+	if (net.inputSize() != (windowWidth / factor) * (windowHeight / factor)) {
+		throw std::invalid_argument("the input layer of " + name + " isn't the size of the downsampled window");
+	}
+	stages.push_back({ name, &net, factor, score, threshold, { 0, 0, 0 } });
+}
+
+template<typename T, typename Acc>
+void Cascade<T, Acc>::downsample(const T* window, int width, int height, int factor, T* dst) {
+
+	int w = width / factor, h = height / factor;
+	T scale = T(1) / (factor * factor);
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			Acc sum = 0;
+			for (int y2 = 0; y2 < factor; y2++) {
+				const T* src = window + (y*factor + y2)*width + x*factor;
+				for (int x2 = 0; x2 < factor; x2++) { sum += src[x2]; }
+			}
+			dst[y*w + x] = T(sum) * scale;
+		}
+	}
+}
+
+template<typename T, typename Acc>
+T Cascade<T, Acc>::normalize(const T* window, int size, T* dst) {
+
+	auto extremums = std::minmax_element(window, window + size);
+	T lowest = *extremums.first, range = *extremums.second - lowest;
+	T scaling = range > 0 ? 1 / range : 0;
+	for (int k = 0; k < size; k++) { dst[k] = (window[k] - lowest) * scaling; }
+	return range;
+}
+
+template<typename T, typename Acc>
+typename Cascade<T, Acc>::Workspace Cascade<T, Acc>::createWorkspace() const {
+
+	Workspace ws;
+	for (const Stage& stage : stages) {
+		ws.nets.push_back(stage.net != NULL ? stage.net->createWorkspace() : typename Network<T, Acc>::Workspace());
+	}
+	return ws;
+}
+
+// scores of the windows of the indices, for the network stage s
+template<typename T, typename Acc>
+void Cascade<T, Acc>::scoreStage(int s, const T* windows, const int* indices, int count, double* scores, Workspace& ws) const {
+
+	const Stage& stage = stages[s];
+	int windowSize = windowWidth * windowHeight;
+
+	// the windows, downsampled, in a matrix for the batch inference
+	int inputSize = stage.net->inputSize(), outputSize = stage.net->outputSize();
+	ws.inputs.resize(size_t(count) * inputSize);
+	ws.outputs.resize(size_t(count) * outputSize);
+	for (int i = 0; i < count; i++) {
+		const T* window = windows + size_t(indices[i]) * windowSize;
+		T* input = ws.inputs.data() + size_t(i) * inputSize;
+		if (stage.factor == 1) { std::copy(window, window + windowSize, input); }
+		else { downsample(window, windowWidth, windowHeight, stage.factor, input); }
+	}
+	stage.net->applyBatch(ws.inputs.data(), ws.outputs.data(), count, ws.nets[s]);
+	for (int i = 0; i < count; i++) {
+		scores[i] = stage.score(ws.inputs.data() + size_t(i) * inputSize, ws.outputs.data() + size_t(i) * outputSize);
+	}
+}
+
+template<typename T, typename Acc>
+int Cascade<T, Acc>::applyRanges(const T* ranges, int count, int* kept) const {
+
+	int n = count;
+	for (int i = 0; i < count; i++) { kept[i] = i; }
+	std::vector<Statistics> statistics(nbRangeStages, { 0, 0, 0 });
+	for (int s = 0; s < nbRangeStages && n > 0; s++) {
+		auto start = std::chrono::steady_clock::now();
+		int remaining = 0;
+		for (int i = 0; i < n; i++) {
+			if (ranges[kept[i]] >= stages[s].threshold) { kept[remaining++] = kept[i]; }
+		}
+		statistics[s].windows = n;
+		statistics[s].rejected = n - remaining;
+		statistics[s].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		n = remaining;
+	}
+	addStatistics(statistics);
+	return n;
+}
+
+template<typename T, typename Acc>
+void Cascade<T, Acc>::apply(const T* windows, int count, double* confidences, Workspace& ws) const {
+
+	std::fill(confidences, confidences + count, nbRangeStages < stages.size() ? -std::numeric_limits<double>::infinity() : 0.0);
+	ws.remaining.resize(count);
+	for (int i = 0; i < count; i++) { ws.remaining[i] = i; }
+
+	std::vector<Statistics> statistics(stages.size(), { 0, 0, 0 });
+	for (int s = nbRangeStages; s < stages.size() && !ws.remaining.empty(); s++) {
+		auto start = std::chrono::steady_clock::now();
+		int n = ws.remaining.size();
+		ws.scores.resize(n);
+		scoreStage(s, windows, ws.remaining.data(), n, ws.scores.data(), ws);
+
+		// only the windows above the threshold remain
+		int kept = 0;
+		for (int i = 0; i < n; i++) {
+			if (ws.scores[i] < stages[s].threshold) { continue; }
+			if (s == stages.size() - 1) { confidences[ws.remaining[i]] = ws.scores[i]; }
+			ws.remaining[kept++] = ws.remaining[i];
+		}
+		ws.remaining.resize(kept);
+
+		statistics[s].windows = n;
+		statistics[s].rejected = n - kept;
+		statistics[s].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	addStatistics(statistics);
+}
+
+// adds the statistics of a call to those of the stages (from the first one)
+template<typename T, typename Acc>
+void Cascade<T, Acc>::addStatistics(const std::vector<Statistics>& statistics) const {
+
+	std::lock_guard<std::mutex> lock(*mutex);
+	for (int s = 0; s < statistics.size(); s++) {
+		Statistics& total = stages[s].statistics;
+		total.windows += statistics[s].windows;
+		total.rejected += statistics[s].rejected;
+		total.seconds += statistics[s].seconds;
+	}
+}
+
+template<typename T, typename Acc>
+void Cascade<T, Acc>::calibrate(const T* positives, int count, double recall) {
+
+	// the positives as a detector gives them to the stages : their ranges, and normalized
+	int windowSize = windowWidth * windowHeight;
+	std::vector<T> ranges(count), windows(size_t(count) * windowSize);
+	for (int i = 0; i < count; i++) {
+		ranges[i] = normalize(positives + size_t(i) * windowSize, windowSize, windows.data() + size_t(i) * windowSize);
+	}
+
+	Workspace ws = createWorkspace();
+	std::vector<int> remaining(count);
+	for (int i = 0; i < count; i++) { remaining[i] = i; }
+	std::vector<double> scores, sorted;
+	for (int s = 0; s < stages.size() && !remaining.empty(); s++) {
+		int n = remaining.size();
+		scores.resize(n);
+		if (s < nbRangeStages) {
+			for (int i = 0; i < n; i++) { scores[i] = ranges[remaining[i]]; }
+		}
+		else { scoreStage(s, windows.data(), remaining.data(), n, scores.data(), ws); }
+
+		// the highest threshold that keeps recall of them
+		sorted = scores;
+		int rejected = std::min(int((1 - recall) * n), n - 1);
+		std::nth_element(sorted.begin(), sorted.begin() + rejected, sorted.end());
+		stages[s].threshold = sorted[rejected];
+
+		int kept = 0;
+		for (int i = 0; i < n; i++) {
+			if (scores[i] >= stages[s].threshold) { remaining[kept++] = remaining[i]; }
+		}
+		remaining.resize(kept);
+	}
+}
+
+template<typename T, typename Acc>
+std::vector<typename Cascade<T, Acc>::Statistics> Cascade<T, Acc>::statistics() const {
+
+	std::lock_guard<std::mutex> lock(*mutex);
+	std::vector<Statistics> all;
+	for (const Stage& stage : stages) { all.push_back(stage.statistics); }
+	return all;
+}
+
+template<typename T, typename Acc>
+void Cascade<T, Acc>::resetStatistics() {
+
+	std::lock_guard<std::mutex> lock(*mutex);
+	for (Stage& stage : stages) { stage.statistics = { 0, 0, 0 }; }
+}
+
+template<typename T, typename Acc>
+void Cascade<T, Acc>::printStatistics(std::ostream& out) const {
+
+	std::vector<Statistics> all = statistics();
+	std::streamsize precision = out.precision();
+	for (int s = 0; s < stages.size(); s++) {
+		const Statistics& st = all[s];
+		out << stages[s].name << " : " << st.windows << " windows, "
+			<< std::fixed << std::setprecision(1) << (st.windows > 0 ? 100.0 * st.rejected / st.windows : 0.0) << "% rejected, "
+			<< std::setprecision(3) << st.seconds << " s";
+		if (st.windows > 0) { out << " (" << std::setprecision(2) << 1e6 * st.seconds / st.windows << " us per window)"; }
+		out << std::defaultfloat << std::setprecision(precision) << std::endl;
+	}
+}
+
+template class Cascade<double, double>;
+template class Cascade<float, float>;
+template class Cascade<float, double>;
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "NeuralNetwork.h"
+
+// windows (windowWidth x windowHeight values, row-major) scored by stages of increasing cost : a window is rejected at
+// the first stage whose score is below its threshold, only the remaining ones are given to the next stage
+// the first stages may test the range of the raw window (its max - min), before it is normalized to [0;1] by its min and
+// max ; the next ones are networks on the normalized window (possibly downsampled), referenced, not copied
+template<typename T, typename Acc = T>
+class Cascade
+{
+public:
+	// confidence of a window (the values given to the network) from the outputs of the network : the higher, the better
+	typedef std::function<double(const T* window, const T* outputs)> Score;
+
+	struct Statistics {
+		long long windows; // given to the stage
+		long long rejected;
+		double seconds;
+	};
+
+	// buffers of a thread
+	struct Workspace {
+		std::vector<typename Network<T, Acc>::Workspace> nets; // per stage
+		std::vector<T> inputs, outputs;
+		std::vector<int> remaining; // windows that weren't rejected yet
+		std::vector<double> scores;
+	};
+
+private:
+	struct Stage {
+		std::string name;
+		const Network<T, Acc>* net; // NULL for the range test
+		int factor; // of the downsampling of the window, for the network
+		Score score;
+		double threshold;
+		mutable Statistics statistics; // (of apply, which is const)
+	};
+	int windowWidth, windowHeight;
+	std::vector<Stage> stages;
+	int nbRangeStages; // (the first stages)
+	mutable std::unique_ptr<std::mutex> mutex; // of the statistics
+
+	void scoreStage(int s, const T* windows, const int* indices, int count, double* scores, Workspace& ws) const;
+	void addStatistics(const std::vector<Statistics>& statistics) const;
+
+public:
+	Cascade(int windowWidth, int windowHeight);
+
+	// range of the values of the raw window (rejects flat windows, before they are normalized : a detector has the min and
+	// max of all its windows) ; throws std::invalid_argument after a network stage
+	void addRangeStage(double threshold = 0);
+	// network on the window downsampled by factor (averages of factor x factor blocks)
+	// throws std::invalid_argument if the dimensions of the window aren't multiples of factor, or if they don't match the input layer
+	void addNetworkStage(const std::string& name, const Network<T, Acc>& net, Score score, int factor = 1,
+		double threshold = -std::numeric_limits<double>::infinity());
+
+	int width() const { return windowWidth; }
+	int height() const { return windowHeight; }
+	int size() const { return stages.size(); }
+	double threshold(int stage) const { return stages[stage].threshold; }
+	void setThreshold(int stage, double threshold) { stages[stage].threshold = threshold; }
+
+	// thresholds of the stages, in their order : each one keeps recall of the positive windows that the previous ones kept
+	// (the overall recall is recall ^ nb of stages) ; the positives are raw windows, normalized as a detector does
+	void calibrate(const T* positives, int count, double recall);
+
+	Workspace createWorkspace() const;
+	// first step of the scoring of count windows : the range stages, from the ranges of the raw windows ;
+	// the indices of the windows that pass them (kept), returns their number
+	int applyRanges(const T* ranges, int count, int* kept) const;
+	// then the network stages on these windows, normalized : confidences are the score of the last stage (0 if there are
+	// only range stages), -infinity for the rejected windows
+	// (both may be called by several threads at once, with their own workspace)
+	void apply(const T* windows, int count, double* confidences, Workspace& ws) const;
+
+	// window normalized to [0;1] by its min and max (a flat window is 0), as a detector does ; returns its range
+	// (dst may be window)
+	static T normalize(const T* window, int size, T* dst);
+
+	// of all the windows given to apply, per stage
+	std::vector<Statistics> statistics() const;
+	void resetStatistics();
+	void printStatistics(std::ostream& out) const; // rejection rate and time of each stage
+
+	// averages of the factor x factor blocks of a width x height window : (width / factor) x (height / factor) values
+	static void downsample(const T* window, int width, int height, int factor, T* dst);
+};
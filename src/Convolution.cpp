@@ -0,0 +1,145 @@
+#include "Convolution.h"
+#include "Matrix.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+typedef std::complex<double> Complex;
+
+static int nextPowerOf2(int n) {
+
+	int p = 1;
+	while (p < n) { p *= 2; }
+	return p;
+}
+
+// in-place radix-2 FFT of n values (a power of 2) that are step apart, without the 1/n scaling of the inverse
+// twiddles : exp(-2i.pi.k/maxN) for k < maxN/2, with maxN a multiple of n
+static void fft(Complex* data, int n, int step, bool inverse, const std::vector<Complex>& twiddles, int maxN) {
+
+	for (int i = 1, j = 0; i < n; i++) { // bit-reversed order
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1) { j ^= bit; }
+		j ^= bit;
+		if (i < j) { std::swap(data[i*step], data[j*step]); }
+	}
+	for (int length = 2; length <= n; length *= 2) {
+		int twiddleStep = maxN / length;
+		for (int i = 0; i < n; i += length) {
+			for (int j = 0; j < length / 2; j++) {
+				Complex w = inverse ? std::conj(twiddles[j * twiddleStep]) : twiddles[j * twiddleStep];
+				Complex u = data[(i + j)*step], v = data[(i + j + length / 2)*step] * w;
+				data[(i + j)*step] = u + v;
+				data[(i + j + length / 2)*step] = u - v;
+			}
+		}
+	}
+}
+
+// rows x cols values (powers of 2), row-major
+static void fft2D(std::vector<Complex>& data, int rows, int cols, bool inverse, const std::vector<Complex>& twiddles, int maxN) {
+
+	for (int y = 0; y < rows; y++) { fft(data.data() + y*cols, cols, 1, inverse, twiddles, maxN); }
+	for (int x = 0; x < cols; x++) { fft(data.data() + x, rows, cols, inverse, twiddles, maxN); }
+}
+
+// first layer as rows of features : pre-activations of each filter (n x outHeight x outWidth) by products of spectrums
+// (the correlation of the image with a filter is the inverse transform of F(image).conj(F(filter)), without wrapping
+// for the valid positions, as the transforms are at least the size of the image)
+template<typename T, typename Acc>
+static void convolveFFT(const Network<T, Acc>& net, const T* image, int width, int height, int patchWidth, int patchHeight,
+	std::vector<T>& features, ThreadPool& pool) {
+
+	const auto& synapse = net.synapses[0];
+	int n = synapse.outputLayer;
+	int outWidth = width - patchWidth + 1, outHeight = height - patchHeight + 1;
+	int rows = nextPowerOf2(height), cols = nextPowerOf2(width), maxN = std::max(rows, cols);
+	std::vector<Complex> twiddles(maxN / 2);
+	for (int k = 0; k < maxN / 2; k++) { twiddles[k] = std::polar(1.0, -2 * 3.14159265358979323846 * k / maxN); }
+
+	std::vector<Complex> spectrum(size_t(rows) * cols);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) { spectrum[y*cols + x] = double(image[y*width + x]); }
+	}
+	fft2D(spectrum, rows, cols, false, twiddles, maxN);
+
+	features.resize(size_t(n) * outHeight * outWidth);
+	std::atomic<int> nextFilter(0);
+	pool.run(pool.size(), [&](int) {
+		std::vector<Complex> filter(size_t(rows) * cols);
+		for (int f = nextFilter++; f < n; f = nextFilter++) {
+			std::fill(filter.begin(), filter.end(), Complex(0));
+			const T* coeffs = synapse.row(f);
+			for (int y = 0; y < patchHeight; y++) {
+				for (int x = 0; x < patchWidth; x++) { filter[y*cols + x] = double(coeffs[y*patchWidth + x]); }
+			}
+			fft2D(filter, rows, cols, false, twiddles, maxN);
+			for (size_t i = 0; i < filter.size(); i++) { filter[i] = spectrum[i] * std::conj(filter[i]); }
+			fft2D(filter, rows, cols, true, twiddles, maxN);
+
+			T* feature = features.data() + size_t(f) * outHeight * outWidth;
+			double scale = 1.0 / (double(rows) * cols);
+			for (int y = 0; y < outHeight; y++) {
+				for (int x = 0; x < outWidth; x++) { feature[y*outWidth + x] = T(filter[y*cols + x].real() * scale + synapse.bias[f]); }
+			}
+		}
+	});
+}
+
+template<typename T, typename Acc>
+void applyConvolution(const Network<T, Acc>& net, const T* image, int width, int height, int patchWidth, int patchHeight,
+	T* outputs, ThreadPool& pool, ConvolutionMethod method) {
+
+	if (net.inputSize() != patchWidth * patchHeight) { throw std::invalid_argument("the input layer isn't the size of the window"); }
+	int outWidth = width - patchWidth + 1, outHeight = height - patchHeight + 1;
+	if (outWidth <= 0 || outHeight <= 0) { return; }
+
+	const auto& synapse = net.synapses[0];
+	int n = synapse.outputLayer, k = patchWidth * patchHeight, outputSize = net.outputSize();
+
+	// multiply-adds of each method (the FFT ones are scalar, complex, and on transforms of powers of 2)
+	if (method == ConvolutionAuto) {
+		double size = double(nextPowerOf2(height)) * nextPowerOf2(width);
+		double directCost = double(outWidth) * outHeight * n * k;
+		double fftCost = 8 * (2.0 * n + 1) * size * std::log2(size);
+		method = fftCost < directCost ? ConvolutionFFT : ConvolutionIm2Col;
+	}
+
+	std::vector<T> features;
+	if (method == ConvolutionFFT) { convolveFFT(net, image, width, height, patchWidth, patchHeight, features, pool); }
+
+	// each thread takes rows of positions : first layer, then the next ones for the whole row at once
+	std::atomic<int> nextRow(0);
+	pool.run(std::min(pool.size(), outHeight), [&](int) {
+		std::vector<T> windows, values(size_t(outWidth) * n);
+		if (method == ConvolutionIm2Col) { windows.resize(size_t(outWidth) * k); }
+		typename Network<T, Acc>::Workspace ws = net.createWorkspace();
+		for (int y = nextRow++; y < outHeight; y = nextRow++) {
+			if (method == ConvolutionIm2Col) {
+				for (int x = 0; x < outWidth; x++) { // im2col : a window per row of the matrix
+					T* window = windows.data() + size_t(x) * k;
+					for (int y2 = 0; y2 < patchHeight; y2++) {
+						std::copy(image + (y + y2)*width + x, image + (y + y2)*width + x + patchWidth, window + y2*patchWidth);
+					}
+				}
+				for (int x = 0; x < outWidth; x++) { std::copy(synapse.bias.begin(), synapse.bias.end(), values.begin() + size_t(x) * n); }
+				gemmNT<T, Acc>(outWidth, n, k, windows.data(), k, synapse.coefficients.data(), synapse.stride, values.data(), n);
+			}
+			else {
+				for (int f = 0; f < n; f++) {
+					const T* feature = features.data() + (size_t(f) * outHeight + y) * outWidth;
+					for (int x = 0; x < outWidth; x++) { values[size_t(x) * n + f] = feature[x]; }
+				}
+			}
+			applyActivation(synapse.activation, values.data(), values.data(), outWidth * n);
+			net.applyBatchFromLayer(1, values.data(), outputs + size_t(y) * outWidth * outputSize, outWidth, ws);
+		}
+	});
+}
+
+template void applyConvolution(const Network<double, double>&, const double*, int, int, int, int, double*, ThreadPool&, ConvolutionMethod);
+template void applyConvolution(const Network<float, float>&, const float*, int, int, int, int, float*, ThreadPool&, ConvolutionMethod);
+template void applyConvolution(const Network<float, double>&, const float*, int, int, int, int, float*, ThreadPool&, ConvolutionMethod);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "NeuralNetwork.h"
+#include "ThreadPool.h"
+
+// how the first layer is computed over the image
+enum ConvolutionMethod {
+	ConvolutionAuto, // the fastest of both, from the sizes of the image and of the window
+	ConvolutionIm2Col, // the windows of a row of the image are packed into a matrix, multiplied with the coefficients
+	ConvolutionFFT // product of the spectrums of the image and of each filter (for large windows)
+};
+
+// dense evaluation of a network over all the windows of an image (single channel, row-major width x height values) :
+// its first layer takes a patchHeight x patchWidth window (row-major), each of its neurons is a filter that is computed
+// over the whole image at once, then the next layers run on the features of each position
+// outputs : (height - patchHeight + 1) x (width - patchWidth + 1) positions (row-major), of outputSize values each
+// the rows of positions are shared among the threads of the pool (kept by the caller, from one image to the next)
+// throws std::invalid_argument if the input layer isn't the size of the window
+template<typename T, typename Acc>
+void applyConvolution(const Network<T, Acc>& net, const T* image, int width, int height, int patchWidth, int patchHeight,
+	T* outputs, ThreadPool& pool, ConvolutionMethod method = ConvolutionAuto);
@@ -0,0 +1,192 @@
+#include "Dataset.h"
+#include "Learning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+template<typename T>
+Dataset<T>::Dataset(int inputSize, int outputSize, InputType inputType, OutputType outputType, T byteScale) :
+	nbInputs(inputSize), nbOutputs(outputSize), inputType(inputType), outputType(outputType), byteScale(byteScale), mappedBytes(NULL) {}
+
+template<typename T>
+Dataset<T>::Dataset(std::shared_ptr<MappedFile> file, size_t offset, int inputSize, std::vector<int> labels, int nbClasses, T byteScale) :
+	nbInputs(inputSize), nbOutputs(nbClasses), inputType(Bytes), outputType(Labels), byteScale(byteScale),
+	file(file), mappedBytes(file->data() + offset), labels(std::move(labels)) {
+
+	order.resize(this->labels.size());
+	for (int i = 0; i < order.size(); i++) { order[i] = i; }
+}
+
+template<typename T>
+Dataset<T>::Dataset(const std::vector<Sample<T>>& samples) :
+	nbInputs(samples.empty() ? 0 : samples[0].input.size()),
+	nbOutputs(samples.empty() ? 0 : samples[0].output.size()),
+	inputType(Scalars), outputType(Rows), byteScale(T(1) / 255), mappedBytes(NULL) {
+
+	reserve(samples.size());
+	for (const Sample<T>& s : samples) { add(s); }
+}
+
+template<typename T>
+void Dataset<T>::reserve(int nbSamples) {
+
+	if (inputType == Scalars) { inputs.reserve(size_t(nbSamples) * nbInputs); }
+	else if (mappedBytes == NULL) { bytes.reserve(size_t(nbSamples) * nbInputs); }
+	if (outputType == Rows) { outputs.reserve(size_t(nbSamples) * nbOutputs); }
+	else { labels.reserve(nbSamples); }
+	order.reserve(nbSamples);
+}
+
+template<typename T>
+void Dataset<T>::clear() {
+
+	inputs.clear();
+	bytes.clear();
+	file.reset();
+	mappedBytes = NULL;
+	outputs.clear();
+	labels.clear();
+	order.clear();
+}
+
+template<typename T>
+void Dataset<T>::unmap() {
+
+	if (mappedBytes == NULL) { return; }
+	bytes.assign(mappedBytes, mappedBytes + size_t(size()) * nbInputs);
+	mappedBytes = NULL;
+	file.reset();
+}
+
+template<typename T>
+void Dataset<T>::addInput(const T* input) {
+
+	if (inputType == Scalars) { inputs.insert(inputs.end(), input, input + nbInputs); return; }
+	unmap();
+	for (int i = 0; i < nbInputs; i++) { // (rounded to the nearest byte)
+		T byte = std::floor(input[i] / byteScale + T(0.5));
+		bytes.push_back((unsigned char)std::min(std::max(byte, T(0)), T(255)));
+	}
+}
+
+template<typename T>
+void Dataset<T>::addInput(const unsigned char* input) {
+
+	if (inputType == Bytes) {
+		unmap();
+		bytes.insert(bytes.end(), input, input + nbInputs);
+		return;
+	}
+	for (int i = 0; i < nbInputs; i++) { inputs.push_back(input[i] * byteScale); }
+}
+
+template<typename T>
+void Dataset<T>::addOutput(const T* output) {
+
+	if (outputType == Rows) { outputs.insert(outputs.end(), output, output + nbOutputs); return; }
+	labels.push_back(int(std::max_element(output, output + nbOutputs) - output)); // (the class of highest value)
+}
+
+template<typename T>
+void Dataset<T>::addOutput(int label) {
+
+	if (outputType == Labels) { labels.push_back(label); return; }
+	for (int o = 0; o < nbOutputs; o++) { outputs.push_back(o == label ? T(1) : T(0)); }
+}
+
+template<typename T>
+void Dataset<T>::add(const T* input, const T* output) { addInput(input); addOutput(output); order.push_back(order.size()); }
+
+template<typename T>
+void Dataset<T>::add(const T* input, int label) { addInput(input); addOutput(label); order.push_back(order.size()); }
+
+template<typename T>
+void Dataset<T>::add(const unsigned char* input, const T* output) { addInput(input); addOutput(output); order.push_back(order.size()); }
+
+template<typename T>
+void Dataset<T>::add(const unsigned char* input, int label) { addInput(input); addOutput(label); order.push_back(order.size()); }
+
+template<typename T>
+void Dataset<T>::add(const Sample<T>& sample) { add(sample.input.data(), sample.output.data()); }
+
+template<typename T>
+const T* Dataset<T>::input(int i, T* buffer) const {
+
+	size_t offset = size_t(order[i]) * nbInputs;
+	if (inputType == Scalars) { return inputs.data() + offset; }
+	const unsigned char* src = byteRows() + offset;
+	for (int j = 0; j < nbInputs; j++) { buffer[j] = src[j] * byteScale; }
+	return buffer;
+}
+
+template<typename T>
+const T* Dataset<T>::output(int i, T* buffer) const {
+
+	if (outputType == Rows) { return outputs.data() + size_t(order[i]) * nbOutputs; }
+	std::fill(buffer, buffer + nbOutputs, T(0));
+	int label = labels[order[i]];
+	if (label >= 0) { buffer[label] = 1; }
+	return buffer;
+}
+
+template<typename T>
+void Dataset<T>::copyInputs(int first, int count, T* dst) const {
+
+	for (int i = 0; i < count; i++) {
+		T* row = dst + size_t(i) * nbInputs;
+		const T* src = input(first + i, row);
+		if (src != row) { std::copy(src, src + nbInputs, row); }
+	}
+}
+
+template<typename T>
+void Dataset<T>::copyOutputs(int first, int count, T* dst) const {
+
+	for (int i = 0; i < count; i++) {
+		T* row = dst + size_t(i) * nbOutputs;
+		const T* src = output(first + i, row);
+		if (src != row) { std::copy(src, src + nbOutputs, row); }
+	}
+}
+
+template<typename T>
+void Dataset<T>::shuffle(std::mt19937& random) {
+
+	std::shuffle(order.begin(), order.end(), random);
+}
+
+template<typename T>
+Dataset<T> Dataset<T>::subset(int first, int count) const {
+
+	Dataset dst(nbInputs, nbOutputs, inputType, outputType, byteScale);
+	dst.reserve(count);
+	for (int i = first; i < first + count; i++) {
+		size_t s = order[i];
+		if (inputType == Scalars) { dst.addInput(inputs.data() + s * nbInputs); }
+		else { dst.addInput(byteRows() + s * nbInputs); }
+		if (outputType == Rows) { dst.addOutput(outputs.data() + s * nbOutputs); }
+		else { dst.addOutput(labels[s]); }
+		dst.order.push_back(dst.order.size());
+	}
+	return dst;
+}
+
+template<typename T>
+std::vector<Sample<T>> Dataset<T>::toSamples() const {
+
+	std::vector<Sample<T>> samples(size());
+	for (int i = 0; i < size(); i++) {
+		Sample<T>& s = samples[i];
+		s.input.resize(nbInputs);
+		s.output.resize(nbOutputs);
+		const T* in = input(i, s.input.data());
+		if (in != s.input.data()) { std::copy(in, in + nbInputs, s.input.begin()); }
+		const T* out = output(i, s.output.data());
+		if (out != s.output.data()) { std::copy(out, out + nbOutputs, s.output.begin()); }
+	}
+	return samples;
+}
+
+template class Dataset<double>;
+template class Dataset<float>;
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Kernels.h"
+#include "MappedFile.h"
+
+template<typename T> struct Sample;
+
+// samples in flat row-major buffers, instead of two vectors per sample
+// inputs are scalars, or bytes scaled on the fly (eg: pixels, with a scale of 1/255) ;
+// outputs are rows of scalars, or class labels (read as one-hot rows, a negative label gives a row of zeros)
+// samples are accessed by their position in the current order, that shuffle permutes without moving them
+template<typename T = double>
+class Dataset
+{
+public:
+	typedef T Scalar;
+	enum InputType { Scalars, Bytes };
+	enum OutputType { Rows, Labels };
+
+private:
+	int nbInputs, nbOutputs; // sizes of a sample
+	InputType inputType;
+	OutputType outputType;
+	T byteScale; // input = byte * byteScale
+	AlignedVector<T> inputs; // nb samples x nbInputs (Scalars)
+	AlignedVector<unsigned char> bytes; // nb samples x nbInputs (Bytes)
+	std::shared_ptr<MappedFile> file; // if the bytes are viewed in a mapped file instead (they are never written)
+	const unsigned char* mappedBytes;
+	const unsigned char* byteRows() const { return mappedBytes ? mappedBytes : bytes.data(); }
+	AlignedVector<T> outputs; // nb samples x nbOutputs (Rows)
+	std::vector<int> labels; // (Labels)
+	std::vector<int> order; // index of the sample at each position
+
+	void unmap(); // copies the mapped bytes, before they can grow
+	void addInput(const T* input);
+	void addInput(const unsigned char* input);
+	void addOutput(const T* output);
+	void addOutput(int label);
+
+public:
+	Dataset(int inputSize, int outputSize, InputType inputType = Scalars, OutputType outputType = Rows, T byteScale = T(1) / 255);
+	Dataset(const std::vector<Sample<T>>& samples);
+	// Bytes and Labels, with the inputs viewed in a mapped file (labels.size() x inputSize bytes at offset), without copies
+	Dataset(std::shared_ptr<MappedFile> file, size_t offset, int inputSize, std::vector<int> labels, int nbClasses, T byteScale = T(1) / 255);
+
+	int size() const { return order.size(); }
+	int inputSize() const { return nbInputs; }
+	int outputSize() const { return nbOutputs; }
+	InputType getInputType() const { return inputType; }
+	OutputType getOutputType() const { return outputType; }
+
+	void reserve(int nbSamples);
+	void clear(); // removes all samples, but keeps the allocations (and no longer views a mapped file)
+	void add(const T* input, const T* output);
+	void add(const T* input, int label);
+	void add(const unsigned char* input, const T* output);
+	void add(const unsigned char* input, int label);
+	void add(const Sample<T>& sample);
+
+	// sample at position i : the rows are returned in place when they are stored as T, else written to buffer
+	const T* input(int i, T* buffer) const;
+	const T* output(int i, T* buffer) const;
+	int label(int i) const { return labels[order[i]]; } // (Labels)
+	const unsigned char* inputBytes(int i) const { return byteRows() + size_t(order[i]) * nbInputs; } // (Bytes)
+	bool isMapped() const { return mappedBytes != NULL; }
+
+	// samples at positions first ... first+count-1, in a count x inputSize (or outputSize) matrix
+	void copyInputs(int first, int count, T* dst) const;
+	void copyOutputs(int first, int count, T* dst) const;
+
+	void shuffle(std::mt19937& random); // new random order
+	Dataset subset(int first, int count) const; // copy of the samples at these positions
+	std::vector<Sample<T>> toSamples() const;
+};
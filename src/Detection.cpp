@@ -0,0 +1,123 @@
+#include "Detection.h"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+std::vector<Detection> coarseToFine(int width, int height, int windowWidth, int windowHeight, const WindowScorer& scorer,
+	int stride, double threshold) {
+
+	int maxX = width - windowWidth, maxY = height - windowHeight;
+	if (maxX < 0 || maxY < 0) { return {}; }
+	stride = std::max(stride, 1);
+
+	// coarse pass
+	int nbX = maxX / stride + 1, nbY = maxY / stride + 1;
+	std::vector<Detection> coarse;
+	coarse.reserve(size_t(nbX) * nbY);
+	for (int j = 0; j < nbY; j++) {
+		for (int i = 0; i < nbX; i++) { coarse.push_back({ i*stride, j*stride, windowWidth, windowHeight, -1, 0 }); }
+	}
+	scorer(coarse);
+
+	// local maximums of the grid (among equal neighbors, the first one) : two of them are never neighbors
+	std::vector<int> maximums;
+	for (int j = 0; j < nbY; j++) {
+		for (int i = 0; i < nbX; i++) {
+			int index = j*nbX + i;
+			double confidence = coarse[index].confidence;
+			if (confidence <= threshold) { continue; }
+			bool isMaximum = true;
+			for (int j2 = std::max(j - 1, 0); j2 <= std::min(j + 1, nbY - 1) && isMaximum; j2++) {
+				for (int i2 = std::max(i - 1, 0); i2 <= std::min(i + 1, nbX - 1); i2++) {
+					int neighbor = j2*nbX + i2;
+					double c = coarse[neighbor].confidence;
+					if (c > confidence || (c == confidence && neighbor < index)) { isMaximum = false; break; }
+				}
+			}
+			if (isMaximum) { maximums.push_back(index); }
+		}
+	}
+
+	// refinement : all the positions between a maximum and its neighbors, scored at once
+	// (these neighborhoods don't intersect, and the only position of the grid in each of them is the maximum)
+	std::vector<Detection> fine;
+	std::vector<size_t> firsts; // of the positions around each maximum
+	for (int m : maximums) {
+		firsts.push_back(fine.size());
+		int mx = coarse[m].x, my = coarse[m].y;
+		for (int y = std::max(my - stride + 1, 0); y <= std::min(my + stride - 1, maxY); y++) {
+			for (int x = std::max(mx - stride + 1, 0); x <= std::min(mx + stride - 1, maxX); x++) {
+				if (x != mx || y != my) { fine.push_back({ x, y, windowWidth, windowHeight, -1, 0 }); }
+			}
+		}
+	}
+	firsts.push_back(fine.size());
+	if (!fine.empty()) { scorer(fine); }
+
+	// the best position around each maximum
+	std::vector<Detection> detections;
+	for (int k = 0; k < maximums.size(); k++) {
+		Detection best = coarse[maximums[k]];
+		for (size_t i = firsts[k]; i < firsts[k + 1]; i++) {
+			if (fine[i].confidence > best.confidence) { best = fine[i]; }
+		}
+		detections.push_back(best);
+	}
+	return detections;
+}
+
+// intersection over union
+static double overlap(const Detection& a, const Detection& b) {
+
+	int w = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+	int h = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+	if (w <= 0 || h <= 0) { return 0; }
+	double intersection = double(w) * h;
+	return intersection / (double(a.width) * a.height + double(b.width) * b.height - intersection);
+}
+
+std::vector<Detection> nonMaximumSuppression(const std::vector<Detection>& candidates, int maxDetections, double maxOverlap) {
+
+	// heap of the candidates by confidence : only those that are popped get sorted
+	std::vector<int> heap(candidates.size());
+	std::iota(heap.begin(), heap.end(), 0);
+	auto lessConfident = [&](int a, int b) { return candidates[a].confidence < candidates[b].confidence; };
+	std::make_heap(heap.begin(), heap.end(), lessConfident);
+
+	// the kept detections in a grid of cells of the largest window : those a window may intersect are in the 3x3 cells around its own
+	int cellSize = 1;
+	for (const Detection& d : candidates) { cellSize = std::max(cellSize, std::max(d.width, d.height)); }
+	auto cellKey = [](int cx, int cy) { return (long long)(unsigned)cx << 32 | (unsigned)cy; };
+	std::unordered_map<long long, std::vector<int>> cells;
+
+	std::vector<Detection> kept;
+	while (!heap.empty() && kept.size() < maxDetections) {
+		std::pop_heap(heap.begin(), heap.end(), lessConfident);
+		const Detection& d = candidates[heap.back()];
+		heap.pop_back();
+
+		int cx = d.x / cellSize, cy = d.y / cellSize;
+		bool suppressed = false;
+		for (int y = cy - 1; y <= cy + 1 && !suppressed; y++) {
+			for (int x = cx - 1; x <= cx + 1 && !suppressed; x++) {
+				auto cell = cells.find(cellKey(x, y));
+				if (cell == cells.end()) { continue; }
+				for (int k : cell->second) {
+					if (overlap(kept[k], d) > maxOverlap) { suppressed = true; break; }
+				}
+			}
+		}
+		if (!suppressed) {
+			cells[cellKey(cx, cy)].push_back(kept.size());
+			kept.push_back(d);
+		}
+	}
+	return kept;
+}
+
+std::vector<Detection> detect(int width, int height, int windowWidth, int windowHeight, const WindowScorer& scorer,
+	int maxDetections, int stride, double threshold, double maxOverlap) {
+
+	return nonMaximumSuppression(coarseToFine(width, height, windowWidth, windowHeight, scorer, stride, threshold), maxDetections, maxOverlap);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+// a window of an image, classified as label with a confidence (the higher, the better)
+struct Detection {
+	int x, y, width, height;
+	int label;
+	double confidence;
+};
+
+// classifies windows at once : fills the label and the confidence of each window, from its position and size
+typedef std::function<void(std::vector<Detection>& windows)> WindowScorer;
+
+// positions of the windows whose confidence is a local maximum above threshold, without scoring each position :
+// a coarse pass over a grid of step stride, then a dense refinement around its local maximums only
+// (the positions are those of windows inside the image : 0 <= x <= width - windowWidth, 0 <= y <= height - windowHeight)
+std::vector<Detection> coarseToFine(int width, int height, int windowWidth, int windowHeight, const WindowScorer& scorer,
+	int stride = 4, double threshold = 0);
+
+// the maxDetections most confident candidates whose overlap (intersection over union) with a more confident one is
+// at most maxOverlap (0 : they don't intersect), by decreasing confidence
+std::vector<Detection> nonMaximumSuppression(const std::vector<Detection>& candidates, int maxDetections, double maxOverlap = 0);
+
+// both of them
+std::vector<Detection> detect(int width, int height, int windowWidth, int windowHeight, const WindowScorer& scorer,
+	int maxDetections, int stride = 4, double threshold = 0, double maxOverlap = 0);
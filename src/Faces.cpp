@@ -1,112 +1,105 @@
 #include "ImageTest.h"
+#include "ImageCache.h"
+#include "Pipeline.h"
+#include "Pyramid.h"
 
 #include <fstream>
+#include <random>
 #include <assert.h>
 
+typedef float Scalar; // type of the samples and networks (float or double)
+
 void faceTest(std::string folder) {
 
 	// converting the image to samples
-	std::vector<Sample> samples;
+	std::vector<Sample<Scalar>> samples;
 	int w = 32, h = 32;
 
-	// compiling all images to binary, for faster reading
-	std::fstream binImages(folder + "allImages", std::ios::in | std::ios::binary);
-	if (!binImages.is_open()) {
-
-		// reading the list of face images
-		std::string fileListPath = folder + "list.txt";
-		std::fstream fileList(fileListPath, std::ios::in);
-		if (!fileList.is_open()) {
-			std::cerr << "can't open the list of faces : "
-				<< fileListPath << std::endl;
-			return;
-		}
-
-		// reading all the images
-		std::vector<cv::Mat> images;
-		{
-			std::string line;
-			while (std::getline(fileList, line)) {
-				std::cout << line << std::endl;
-				cv::Mat im = cv::imread(folder + line);
-				if (im.empty()) { continue; }
-				images.push_back(im);
-			}
-			fileList.close();
-		}
-
-		// assuming that the first image has the correct size
-		int w0 = images[0].size().width, h0 = images[0].size().height;
-
-		// filtering images that have the wrong size
-		{
-			std::vector<cv::Mat> filteredImages;
-			for (cv::Mat& im : images) {
-				if (im.size().width == w0 && im.size().height == h0) {
-					filteredImages.push_back(im);
+	// compiling all images to a cache, for faster reading (only the new or modified images are decoded)
+	std::string cachePath = folder + "allImages.cache";
+	std::string fileListPath = folder + "list.txt";
+	std::fstream fileList(fileListPath, std::ios::in);
+	if (fileList.is_open()) {
+		try {
+			ImageCacheWriter cacheWriter(cachePath, w, h, 1, ImageCache::NoLabels);
+			int w0 = 0, h0 = 0; // size of the first image read : the images with another size are discarded
+
+			// the images are decoded and resized in parallel, and added to the cache in the order of the list
+			struct FaceImage {
+				std::string path, key;
+				bool cached;
+				cv::Size size; // before resizing
+				cv::Mat im;
+				std::vector<unsigned char> pixels;
+			};
+			Pipeline<FaceImage> ingestion;
+			ingestion.addStage([&](FaceImage& f) { // decoding
+				if (f.cached) { return true; }
+				f.im = cv::imread(folder + f.path);
+				f.size = f.im.size();
+				return !f.im.empty();
+			});
+			ingestion.addStage([&](FaceImage& f) { // resizing and keeping the first channel
+				if (f.cached) { return true; }
+				cv::resize(f.im, f.im, cv::Size(w, h), 0, 0, cv::INTER_AREA);
+				assert(f.im.depth() == CV_8U); // im must be uint8
+				f.pixels.resize(w*h);
+				for (int i = 0; i < w*h; i++) { f.pixels[i] = f.im.data[i*f.im.channels()]; }
+				f.im.release();
+				return true;
+			});
+			ingestion.run(
+				[&](FaceImage& f) { // listing the files
+					if (!std::getline(fileList, f.path)) { return false; }
+					f.key = ImageCache::sourceKey(folder + f.path);
+					f.cached = cacheWriter.hasCached(f.key);
+					return true;
+				},
+				[&](FaceImage& f) {
+					if (f.cached) { cacheWriter.addCached(f.key); return; }
+					std::cout << f.path << std::endl;
+					if (w0 == 0) { w0 = f.size.width; h0 = f.size.height; }
+					if (f.size.width != w0 || f.size.height != h0) { return; }
+					cacheWriter.add(f.pixels.data(), 0, f.key);
 				}
-			}
-			images = filteredImages;
-			std::cout << "found " << images.size()
-				<< " face images" << std::endl;
+			);
+			cacheWriter.finish();
 		}
-
-		for (cv::Mat& im : images) {
-			cv::resize(im, im, cv::Size(w, h), 0, 0, cv::INTER_AREA);
-			assert(im.depth() == CV_8U); // im must be uint8
-			Sample s;
-			for (int i = 0; i < w*h; i++) {
-				s.input.push_back(double(im.data[i*im.channels()]) / 255);
-			}
-			s.output = s.input;
-			samples.push_back(s);
-		}
-
-		// exporting the samples to a binary file
-		binImages = std::fstream(folder + "allImages", std::ios::out | std::ios::binary);
-		if (binImages.is_open()) {
-			int size = samples.size();
-			binImages.write((char*)&size, sizeof(int));
-			for (Sample& s : samples) {
-				std::vector<unsigned char> inputC(w*h);
-				for (int i = 0; i < s.input.size(); i++) { inputC[i] = 255 * s.input[i]; }
-				binImages.write((char*)inputC.data(), inputC.size() * sizeof(unsigned char));
-			}
-		}
-		binImages.close();
+		catch (const std::runtime_error& e) { std::cerr << e.what() << std::endl; }
+		fileList.close();
 	}
-	else { // reading the binary file
-		int nbSamples;
-		binImages.read((char*)&nbSamples, sizeof(int));
-		std::cout << "importing " << nbSamples
-			<< " samples (from bin file)" << std::endl;
-		for (int i = 0; i < nbSamples; i++) {
-			std::vector<unsigned char> inputC(w*h);
-			binImages.read((char*)inputC.data(), w*h*sizeof(unsigned char));
-			std::vector<double> input(w*h);
-			for (int i = 0; i < inputC.size(); i++) { input[i] = inputC[i] / 255.0; }
+	else { std::cerr << "can't open the list of faces : " << fileListPath << " (using the cache)" << std::endl; }
+
+	// reading the cache
+	try {
+		ImageCache cache(cachePath);
+		std::cout << "importing " << cache.size() << " samples (from the cache)" << std::endl;
+		for (int i = 0; i < cache.size(); i++) {
+			const unsigned char* pixels = cache.pixels(i);
+			std::vector<Scalar> input(w*h);
+			for (int k = 0; k < w*h; k++) { input[k] = pixels[k] / Scalar(255); }
 			samples.push_back({ input, input });
 		}
-		binImages.close();
 	}
+	catch (const std::runtime_error& e) { std::cerr << e.what() << std::endl; return; }
 
 	// learning the images
 	int principalComponents = 8;
-	NetLearner learner(Network({ w*h, principalComponents, w*h }, 0.01));
+	NetLearner<Scalar> learner(Network<Scalar>({ w*h, principalComponents, w*h }, 0.01));
 
 	while (true) {
 		learner.learn(samples, 1, 32, 0.1);
 
 		// display the net coeffs for each class (in a row)
 		cv::Mat coeffsViz;
-		double* coeffsP = (double*)learner.net.synapses[0].coefficients.data();
+		Scalar* coeffsP = (Scalar*)learner.net.synapses[0].coefficients.data();
 		std::vector<cv::Mat> coeffs;
 		for (int i = 0; i < principalComponents; i++) {
-			cv::Mat coeff(cv::Size(w, h), CV_64FC1);
-			std::copy( // dont forget the bias
-				coeffsP + i + i*(w*h),
-				coeffsP + i + (i + 1)*(w*h),
-				((double*)coeff.data)
+			cv::Mat coeff(cv::Size(w, h), cv::DataType<Scalar>::type);
+			std::copy( // rows are padded to the SIMD width
+				coeffsP + i*learner.net.synapses[0].stride,
+				coeffsP + i*learner.net.synapses[0].stride + w*h,
+				((Scalar*)coeff.data)
 				);
 			cv::normalize(coeff, coeff, -1, 1, cv::NORM_MINMAX);
 			coeffs.push_back(coeff);
@@ -120,12 +113,12 @@ void faceTest(std::string folder) {
 	}
 
 #if 1 // reconstructing faces from learnt components
-	for (Sample& s : samples) {
+	for (Sample<Scalar>& s : samples) {
 		auto out = learner.apply(s.input);
-		cv::Mat original(cv::Size(w, h), CV_64FC1);
-		std::copy(s.input.begin(), s.input.end(), (double*)original.data);
-		cv::Mat output(cv::Size(w, h), CV_64FC1);
-		std::copy(out.begin(), out.end(), (double*)output.data);
+		cv::Mat original(cv::Size(w, h), cv::DataType<Scalar>::type);
+		std::copy(s.input.begin(), s.input.end(), (Scalar*)original.data);
+		cv::Mat output(cv::Size(w, h), cv::DataType<Scalar>::type);
+		std::copy(out.begin(), out.end(), (Scalar*)output.data);
 		cv::resize(original, original, cv::Size(256,256));
 		cv::resize(output, output, cv::Size(256,256));
 		cv::imshow("src", original); cv::imshow("dst", output);
@@ -139,177 +132,164 @@ void faceTest(std::string folder) {
 		cv::Mat src = cv::imread("../../data/kid.png");
 		cv::cvtColor(src, src, cv::COLOR_RGB2GRAY);
 		cv::imshow("face to detect", src); cv::waitKey(16);
-		src.convertTo(src, CV_64FC1); src = src / 255;
-
-		// for different scales
-		for (float scale = 1; int(src.size().width * scale) > w && int(src.size().height) > h; scale *= 0.8) {
-			
-			// scaling the image
-			cv::Mat srcSmall;
-			cv::resize(
-				src, srcSmall,
-				cv::Size(src.size().width*scale, src.size().height*scale),
-				0, 0, cv::INTER_AREA
-				);
-			int wI = srcSmall.size().width, hI = srcSmall.size().height;
-			cv::Mat dst(cv::Size(wI - w, hI - h), CV_64FC1);
-			double* dstP = (double*)dst.data;
-
-			// for each region of the image
-			for (int y = 0; y < hI - h; y++) {
-				for (int x = 0; x < wI - w; x++) {
-
-					cv::Mat patch(cv::Size(w, h), CV_64FC1);
-					srcSmall(cv::Rect(x, y, w, h)).copyTo(patch);
-					cv::normalize(patch, patch, 0, 1, cv::NORM_MINMAX);
-					std::vector<double> input((double*)patch.data, (double*)patch.data + w*h);
-					std::vector<double> output = learner.apply(input);
-					double error = 0; // reconstruction error from the PCA
-					for (int k = 0; k < w*h; k++) {
-						double diff = input[k] - output[k];
-						error += abs(diff);
-					}
-					dstP[y*(wI - w) + x] = exp(-error/(w*h));
-				}
-			}
+
+		// all scales at once : the confidence of a window is its reconstruction error from the PCA
+		PyramidDetector<Scalar> detector(learner.net, w, h, [&](const Scalar* input, const Scalar* output) {
+			double error = 0;
+			for (int k = 0; k < w*h; k++) { error += abs(input[k] - output[k]); }
+			return exp(-error / (w*h));
+		});
+		std::vector<cv::Mat> maps;
+		std::vector<Detection> faces = detector.detect(src, 0, 4, 0, &maps);
+
+		for (cv::Mat& dst : maps) {
 			cv::normalize(dst, dst, -1, 1, cv::NORM_MINMAX);
 			dst = -128 * dst + 128; dst.convertTo(dst, CV_8U);
 			cv::resize(dst, dst, cv::Size(src.size().width - w, src.size().height - h));
 			cv::applyColorMap(dst, dst, cv::COLORMAP_BONE);
 			cv::imshow("face probabilities", dst); cv::waitKey();
 		}
+		for (const Detection& d : faces) { cv::rectangle(src, cv::Rect(d.x, d.y, d.width, d.height), 255); }
+		cv::imshow("faces found", src); cv::waitKey();
 	}
 }
 
-// http://www.anefian.com/research/GTDB_README.txt
-void faceTest2(std::string folder) {
-
-	int wF = 32, hF = 32; // faces dimensions
-	std::vector<Sample> samples;
-
-	std::string binPath = folder + "allSamples";
-	std::fstream binSamples(binPath, std::ios::in | std::ios::binary);
-	if (binSamples.is_open()) {
-		int nb; binSamples.read((char*)&nb, sizeof(int));
-		std::cout << "importing " << nb << " samples from " << binPath << std::endl;
-		for (int i = 0; i < nb; i++) {
-			std::vector<unsigned char> pixels(wF*hF);
-			binSamples.read((char*)pixels.data(), wF*hF*sizeof(unsigned char));
-			unsigned char label; binSamples.read((char*)&label, sizeof(unsigned char));
-			Sample s;
-			s.input = std::vector<double>(wF*hF);
-			for (int i = 0; i < wF*hF; i++) { s.input[i] = pixels[i] / 255.0; }
-			s.output = { label / 255.0 };
-			samples.push_back(s);
-		}
-	}
-	else {
-		// for each person
-		for (int i = 1; i <= 50; i++) {
-			std::stringstream ss;
-			ss << 100 + i;
-			std::string personFolder = "s" + ss.str().substr(1) + "/",
-				imFolder = folder + "gt_db/" + personFolder;
-
-			// for each image of the person
-			for (int j = 1; j <= 15; j++) {
+// (re)builds the cache of faceTest2 from the database : the images whose file and label didn't change are copied from the
+// previous cache, the others are decoded and cropped in parallel ; returns false if the cache can't be built
+static bool buildFaceSamples(std::string folder, std::string cachePath, int wF, int hF) {
+
+	struct FaceImage {
+		std::string imPath, labelPath, key;
+		bool cached;
+		unsigned seed; // of the position of the non-face (drawn by the source, for deterministic results)
+		cv::Mat im;
+		int x, y, x2, y2; // of the face
+		cv::Mat face, nonFace;
+	};
+
+	try {
+		ImageCacheWriter cacheWriter(cachePath, wF, hF, 1, ImageCache::ClassLabels);
+		Pipeline<FaceImage> ingestion;
+
+		ingestion.addStage([&](FaceImage& f) { // reading the image and its label
+			if (f.cached) { return true; }
+			f.im = cv::imread(f.imPath);
+			if (f.im.empty()) { throw std::runtime_error("can't read " + f.imPath); }
+			std::fstream label(f.labelPath, std::ios::in);
+			if (!label.is_open()) { throw std::runtime_error("can't read " + f.labelPath); }
+			label >> f.x >> f.y >> f.x2 >> f.y2;
+			return true;
+		});
+
+		ingestion.addStage([&](FaceImage& f) {
+			if (f.cached) { return true; }
+			cv::Mat& im = f.im;
+			int x = f.x, y = f.y;
+
+			// Getting the face
+			int w = f.x2 - x, h = f.y2 - y;
+			cv::Mat face(cv::Size(w, h), CV_8UC3);
+			im(cv::Rect(x, y, w, h)).copyTo(face);
+
+			// downscaling it (TODO : check ratio)
+			double ratio = min(double(w) / wF, double(h) / hF);
+			cv::resize(face, face, cv::Size(w / ratio, h / ratio), 0, 0, cv::INTER_AREA);
+
+			w = face.size().width, h = face.size().height;
+			cv::Mat cropped(cv::Size(wF, hF), CV_8UC1);
+			face(cv::Rect(0, h - hF, wF, hF)).copyTo(cropped);
+			//cv::imshow("z", cropped); cv::waitKey();
+			cv::cvtColor(cropped, f.face, cv::COLOR_RGB2GRAY);
+
+			cv::Mat imS;
+			cv::resize(im, imS, cv::Size(im.size().width / ratio, im.size().height / ratio), 0, 0, cv::INTER_AREA);
+			cv::cvtColor(imS, imS, cv::COLOR_RGB2GRAY);
+
+			// extracting a non-face image
+			int xS = x / ratio, yS = y / ratio;
+			std::minstd_rand random(f.seed);
+			std::uniform_real_distribution<double> uniform(0, 1);
+			while (true) {
+				int xRand = (imS.size().width - wF) * uniform(random);
+				int yRand = (imS.size().height - hF) * uniform(random);
+
+				// if to close from face, discard it
+				if ((xRand - xS)*(xRand - xS) + (yRand - yS)*(yRand - yS) < wF*hF / 16) { continue; }
+
+				cv::Mat nonFace;
+				im(cv::Rect(xRand, yRand, wF, hF)).copyTo(nonFace);
+				cv::cvtColor(nonFace, f.nonFace, cv::COLOR_RGB2GRAY);
+				break;
+			}
+			im.release();
+			return true;
+		});
+
+		int i = 1, j = 1; // person and image of the next sample
+		ingestion.run(
+			[&](FaceImage& f) {
+				if (i > 50) { return false; }
+				std::stringstream ss;
+				ss << 100 + i;
+				std::string personFolder = "s" + ss.str().substr(1) + "/",
+					imFolder = folder + "gt_db/" + personFolder;
 				std::stringstream ss2;
 				ss2 << 100 + j;
-				std::string imPath = imFolder + ss2.str().substr(1) + ".jpg";
-
-				// reading the image
-				cv::Mat im = cv::imread(imPath);
-				if (im.empty()) {
-					std::cerr << "can't read " << imPath << std::endl;
-					return;
-				}
-
-				// reading the label
+				f.imPath = imFolder + ss2.str().substr(1) + ".jpg";
 				std::stringstream ss3;
 				ss3 << 1000 + 20 * (i - 1) + j;
-				std::string labelPath = folder + "labels/" +
+				f.labelPath = folder + "labels/" +
 					+"lab" + ss3.str().substr(1);
-				std::fstream label(labelPath, std::ios::in);
-				if (!label.is_open()) {
-				std:cerr << "can't read " << labelPath << std::endl;
+
+				// both samples of the image are kept if neither file changed
+				f.key = ImageCache::sourceKey(f.imPath) + ';' + ImageCache::sourceKey(f.labelPath);
+				f.cached = cacheWriter.hasCached(f.key + "#face") && cacheWriter.hasCached(f.key + "#background");
+				f.seed = rand();
+				if (++j > 15) { j = 1; i++; } // 50 persons, 15 images each
+				return true;
+			},
+			[&](FaceImage& f) {
+				if (f.cached) {
+					cacheWriter.addCached(f.key + "#face");
+					cacheWriter.addCached(f.key + "#background");
 					return;
 				}
-				int x, y, x2, y2;
-				label >> x >> y >> x2 >> y2;
-
-				// Getting the face
-				int w = x2 - x, h = y2 - y;
-				cv::Mat face(cv::Size(w, h), CV_8UC3);
-				{
-					im(cv::Rect(x, y, w, h)).copyTo(face);
-
-					// downscaling it (TODO : check ratio)
-					double ratio = min(double(w) / wF, double(h) / hF);
-					cv::resize(face, face, cv::Size(w / ratio, h / ratio), 0, 0, cv::INTER_AREA);
-
-					int w = face.size().width, h = face.size().height;
-					cv::Mat cropped(cv::Size(wF, hF), CV_8UC1);
-					face(cv::Rect(0, h - hF, wF, hF)).copyTo(cropped);
-					//cv::imshow("z", cropped); cv::waitKey();
-					cv::cvtColor(cropped, cropped, cv::COLOR_RGB2GRAY);
-
-					Sample s;
-					s.input = std::vector<double>(wF*hF);
-					for (int i = 0; i < wF*hF; i++) { s.input[i] = cropped.data[i] / 255.0; }
-					s.output = { 1.0 }; // 1 because it is a face
-					samples.push_back(s);
-
-					cv::Mat imS;
-					cv::resize(im, imS, cv::Size(im.size().width / ratio, im.size().height / ratio), 0, 0, cv::INTER_AREA);
-					cv::cvtColor(imS, imS, cv::COLOR_RGB2GRAY);
-
-					// extracting a non-face image
-					int xS = x / ratio, yS = y / ratio;
-					bool found = false;
-					while (!found) {
-						int xRand = (imS.size().width - wF) * double(rand()) / RAND_MAX;
-						int yRand = (imS.size().height - hF) * double(rand()) / RAND_MAX;
-
-						// if to close from face, discard it
-						if ((xRand - xS)*(xRand - xS) + (yRand - yS)*(yRand - yS) < wF*hF / 16) { continue; }
-
-						found = true;
-						cv::Mat nonFace;
-						im(cv::Rect(xRand, yRand, wF, hF)).copyTo(nonFace);
-						cv::cvtColor(nonFace, nonFace, cv::COLOR_RGB2GRAY);
-
-						Sample s;
-						s.input = std::vector<double>(wF*hF);
-						for (int i = 0; i < wF*hF; i++) { s.input[i] = nonFace.data[i] / 255.0; }
-						s.output = { 0 };
-						samples.push_back(s);
-					}
-				}
-
-				//cv::rectangle(im, { x,y,w,h }, { 0,255,0 });
-				//cv::imshow("k", im); cv::waitKey(1);
+				cacheWriter.add(f.face.data, 1, f.key + "#face"); // 1 because it is a face
+				cacheWriter.add(f.nonFace.data, 0, f.key + "#background");
 			}
-		}
+		);
+		cacheWriter.finish();
+	}
+	catch (const std::runtime_error& e) { std::cerr << e.what() << std::endl; return false; }
+	return true;
+}
 
-		// exporting to binary file
-		binSamples = std::fstream(binPath, std::ios::out | std::ios::binary);
-		if (!binSamples.is_open()) { std::cerr << "can't write to " << binPath << std::endl; }
-		else {
-			int nb = samples.size();
-			binSamples.write((char*)&nb, sizeof(int));
-			for (const Sample& s : samples) {
-				std::vector<unsigned char> pixels(wF*hF);
-				for (int i = 0; i < wF*hF; i++) { pixels[i] = s.input[i] * 255; }
-				binSamples.write((char*)pixels.data(), wF*hF*sizeof(unsigned char));
-				unsigned char label = s.output[0] * 255;
-				binSamples.write((char*)&label, sizeof(unsigned char));
-			}
+// http://www.anefian.com/research/GTDB_README.txt
+void faceTest2(std::string folder) {
+
+	int wF = 32, hF = 32; // faces dimensions
+	std::vector<Sample<Scalar>> samples;
+
+	// compiling the faces and non-faces to a cache (only the new or modified images are decoded)
+	std::string cachePath = folder + "allSamples.cache";
+	if (!buildFaceSamples(folder, cachePath, wF, hF)) { std::cerr << "using the cache" << std::endl; }
+	try {
+		ImageCache cache(cachePath);
+		std::cout << "importing " << cache.size() << " samples from " << cachePath << std::endl;
+		for (int i = 0; i < cache.size(); i++) {
+			const unsigned char* pixels = cache.pixels(i);
+			Sample<Scalar> s;
+			s.input = std::vector<Scalar>(wF*hF);
+			for (int k = 0; k < wF*hF; k++) { s.input[k] = pixels[k] / Scalar(255); }
+			s.output = { Scalar(cache.label(i)) }; // 1 for faces, 0 otherwise
+			samples.push_back(s);
 		}
 	}
+	catch (const std::runtime_error& e) { std::cerr << e.what() << std::endl; return; }
 
 #if 0
 	// displaying the samples
-	for (const Sample& s : samples) {
+	for (const Sample<Scalar>& s : samples) {
 		cv::Mat face(cv::Size(wF,hF),CV_8UC1);
 		for (int i = 0; i < wF*hF; i++) { face.data[i] = s.input[i] * 255; }
 		cv::resize(face, face, cv::Size(8 * wF, 8 * hF), 0, 0, cv::INTER_NEAREST);
@@ -318,32 +298,38 @@ void faceTest2(std::string folder) {
 #endif
 
 	int nbComponents = 10;
-	NetLearner classifier(Network({ wF*hF, nbComponents, 1 }, 0.001));
+	NetLearner<Scalar> classifier(Network<Scalar>({ wF*hF, nbComponents, 1 }, 0.001));
 
 	int nbToLearn = 80 * samples.size() / 100;
 	//std::random_shuffle(samples.begin(), samples.end());
-	std::vector<Sample>& learningSamples = std::vector<Sample>(samples.begin(),samples.begin()+nbToLearn);
-	std::vector<Sample>& testingSamples = std::vector<Sample>(samples.begin() + nbToLearn,samples.end());
+	std::vector<Sample<Scalar>>& learningSamples = std::vector<Sample<Scalar>>(samples.begin(),samples.begin()+nbToLearn);
+	std::vector<Sample<Scalar>>& testingSamples = std::vector<Sample<Scalar>>(samples.begin() + nbToLearn,samples.end());
+
+	// the networks learn the windows as the cascade scores them : normalized by their min and max
+	// (samples keeps the raw ones, to calibrate the cascade)
+	for (Sample<Scalar>& s : learningSamples) { Cascade<Scalar>::normalize(s.input.data(), wF*hF, s.input.data()); }
+	for (Sample<Scalar>& s : testingSamples) { Cascade<Scalar>::normalize(s.input.data(), wF*hF, s.input.data()); }
 	
 	while (true) {
 		classifier.learn(learningSamples, 1, 8);
 		int error = 0;
-		for (Sample& s : testingSamples) {
-			double result = classifier.apply(s.input)[0];
+		for (Sample<Scalar>& s : testingSamples) {
+			Scalar result;
+			classifier.apply(s.input.data(), &result);
 			if ((result < 0.5) != (s.output[0] < 0.5)) { error++; }
 		}
 		std::cout << "error on Test is " << (error*100.0) / testingSamples.size() << "%" << std::endl;
 
 		// TODO : generic function to display the coeffs of a network
 		cv::Mat coeffsViz;
-		double* coeffsP = (double*)classifier.net.synapses[0].coefficients.data();
+		Scalar* coeffsP = (Scalar*)classifier.net.synapses[0].coefficients.data();
 		std::vector<cv::Mat> coeffs;
 		for (int i = 0; i < nbComponents; i++) {
-			cv::Mat coeff(cv::Size(wF, hF), CV_64FC1);
-			std::copy( // dont forget the bias
-				coeffsP + i + i*(wF*hF),
-				coeffsP + i + (i + 1)*(wF*hF),
-				((double*)coeff.data)
+			cv::Mat coeff(cv::Size(wF, hF), cv::DataType<Scalar>::type);
+			std::copy( // rows are padded to the SIMD width
+				coeffsP + i*classifier.net.synapses[0].stride,
+				coeffsP + i*classifier.net.synapses[0].stride + wF*hF,
+				((Scalar*)coeff.data)
 				);
 			coeffs.push_back(coeff);
 		}
@@ -355,4 +341,58 @@ void faceTest2(std::string folder) {
 		cv::imshow("coeffs", coeffsViz);
 		if (cv::waitKey(16) == 27) { break; };
 	}
+
+	// detecting faces with a cascade : the flat windows, then a tiny network on the windows downsampled to 8x8, then the classifier
+	{
+		int factor = 4, wS = wF / factor, hS = hF / factor;
+		std::vector<Sample<Scalar>> smallSamples; // (from the normalized windows, as the cascade downsamples them)
+		for (const Sample<Scalar>& s : learningSamples) {
+			Sample<Scalar> small;
+			small.input = std::vector<Scalar>(wS*hS);
+			Cascade<Scalar>::downsample(s.input.data(), wF, hF, factor, small.input.data());
+			small.output = s.output;
+			smallSamples.push_back(small);
+		}
+		NetLearner<Scalar> quickClassifier(Network<Scalar>({ wS*hS, 4, 1 }, 0.001));
+		for (int i = 0; i < 20; i++) { quickClassifier.learn(smallSamples, 1, 8); }
+
+		Cascade<Scalar> cascade(wF, hF);
+		auto isFace = [](const Scalar*, const Scalar* output) { return double(output[0]); };
+		cascade.addRangeStage();
+		cascade.addNetworkStage("8x8 classifier", quickClassifier.net, isFace, factor);
+		cascade.addNetworkStage("classifier", classifier.net, isFace);
+
+		// thresholds keeping 99% of the test faces at each stage (raw : the cascade normalizes them as the detector does)
+		std::vector<Scalar> faces;
+		for (int i = nbToLearn; i < samples.size(); i++) {
+			if (samples[i].output[0] >= 0.5) { faces.insert(faces.end(), samples[i].input.begin(), samples[i].input.end()); }
+		}
+		cascade.calibrate(faces.data(), faces.size() / (wF*hF), 0.99);
+
+		cv::Mat src = cv::imread("../../data/kid.png");
+		if (src.empty()) { std::cerr << "can't read ../../data/kid.png" << std::endl; return; }
+		cv::cvtColor(src, src, cv::COLOR_RGB2GRAY);
+		PyramidDetector<Scalar> detector(cascade);
+		std::vector<Detection> found = detector.detect(src, 0.5, 8, 0.3);
+		cascade.printStatistics(std::cout);
+
+		for (const Detection& d : found) { cv::rectangle(src, cv::Rect(d.x, d.y, d.width, d.height), 255); }
+		cv::imshow("faces found", src); cv::waitKey();
+
+		// on the camera stream, if there is one : only the windows over what moved are scored again
+		cv::VideoCapture camera(0);
+		if (!camera.isOpened()) { return; }
+		StreamingDetector<Scalar> stream(detector);
+		cascade.resetStatistics();
+		cv::Mat frame;
+		while (camera.read(frame)) {
+			cv::cvtColor(frame, frame, cv::COLOR_BGR2GRAY);
+			found = stream.detect(frame, 0.5, 8, 0.3);
+			for (const Detection& d : found) { cv::rectangle(frame, cv::Rect(d.x, d.y, d.width, d.height), 255); }
+			std::cout << int(100 * stream.lastUpdate()) << "% of the windows scored" << std::endl;
+			cv::imshow("faces found", frame);
+			if (cv::waitKey(1) == 27) { break; }
+		}
+		cascade.printStatistics(std::cout);
+	}
 }
\ No newline at end of file
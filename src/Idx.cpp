@@ -0,0 +1,49 @@
+#include "Idx.h"
+
+#include <stdexcept>
+
+static int readBigEndian(const unsigned char* p) {
+
+	return int((unsigned(p[0]) << 24) | (unsigned(p[1]) << 16) | (unsigned(p[2]) << 8) | unsigned(p[3]));
+}
+
+IdxFile::IdxFile(const std::string& fileName, int nbDimensions) : file(std::make_shared<MappedFile>(fileName)) {
+
+	const unsigned char* p = file->data();
+	size_t size = file->size();
+	if (size < 4 || p[0] != 0 || p[1] != 0 || p[2] != 0x08) { throw std::runtime_error(fileName + " isn't an IDX file of unsigned bytes"); }
+	if (p[3] != nbDimensions) { throw std::runtime_error(fileName + " has " + std::to_string(p[3]) + " dimensions instead of " + std::to_string(nbDimensions)); }
+	if (size < 4 + 4 * size_t(nbDimensions)) { throw std::runtime_error(fileName + " is truncated"); }
+
+	for (int i = 0; i < nbDimensions; i++) {
+		int dim = readBigEndian(p + 4 + 4 * i);
+		if (dim <= 0) { throw std::runtime_error(fileName + " has an invalid dimension"); }
+		dimensions.push_back(dim);
+	}
+	if (offset() + size_t(count()) * itemSize() > size) { throw std::runtime_error(fileName + " is truncated"); }
+}
+
+size_t IdxFile::itemSize() const {
+
+	size_t size = 1;
+	for (int i = 1; i < dimensions.size(); i++) { size *= dimensions[i]; }
+	return size;
+}
+
+template<typename T>
+Dataset<T> loadMNIST(const std::string& imagesFileName, const std::string& labelsFileName) {
+
+	IdxFile images(imagesFileName, 3), labelsFile(labelsFileName, 1);
+	if (images.dims()[1] != 28 || images.dims()[2] != 28) { throw std::runtime_error(imagesFileName + " doesn't have 28 x 28 images"); }
+	if (images.count() != labelsFile.count()) { throw std::runtime_error(imagesFileName + " and " + labelsFileName + " have different counts"); }
+
+	// the labels are few : read once
+	std::vector<int> labels(labelsFile.data(), labelsFile.data() + labelsFile.count());
+	for (int label : labels) {
+		if (label > 9) { throw std::runtime_error(labelsFileName + " has an invalid label"); }
+	}
+	return Dataset<T>(images.mapping(), images.offset(), int(images.itemSize()), std::move(labels), 10);
+}
+
+template Dataset<double> loadMNIST(const std::string&, const std::string&);
+template Dataset<float> loadMNIST(const std::string&, const std::string&);
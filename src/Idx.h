@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Dataset.h"
+#include "MappedFile.h"
+
+// IDX file of unsigned bytes (the format of the MNIST files), mapped in memory :
+// big-endian header (magic = 0x0000 0x08 nbDimensions, then the dimensions), followed by the values
+class IdxFile
+{
+	std::shared_ptr<MappedFile> file;
+	std::vector<int> dimensions;
+
+public:
+	// throws std::runtime_error if the file can't be mapped, isn't an IDX file of bytes with nbDimensions, or is truncated
+	IdxFile(const std::string& fileName, int nbDimensions);
+
+	const std::vector<int>& dims() const { return dimensions; }
+	int count() const { return dimensions[0]; }
+	size_t itemSize() const; // nb of bytes per item (product of the other dimensions)
+	size_t offset() const { return 4 + 4 * dimensions.size(); } // of the values in the file
+	const unsigned char* data() const { return file->data() + offset(); } // count x itemSize bytes
+	std::shared_ptr<MappedFile> mapping() const { return file; }
+};
+
+// MNIST images (28 x 28) and labels files as a Dataset of Bytes and Labels (10 classes) ;
+// the pixels stay in the mapped file, and are scaled to [0;1] when the samples are read
+// throws std::runtime_error if the files are invalid or their counts differ
+template<typename T>
+Dataset<T> loadMNIST(const std::string& imagesFileName, const std::string& labelsFileName);
@@ -1,98 +1,289 @@
 #include "Image.h"
 
-ImageFilterLearner::ImageFilterLearner(int patchSize, std::vector<int> hiddenLayers) :
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+ImageFilterLearner::ImageFilterLearner(int patchSize, std::vector<int> hiddenLayers, Output output) :
 	patchSize(patchSize),
-	learner(Network({ patchSize*patchSize,1 })) // HACK
+	outputType(output),
+	learner(Network<>({ patchSize*patchSize,1 })) // HACK
 {
 	std::vector<int> layers;
 	layers.push_back(patchSize*patchSize);
 	layers.insert(layers.end(),hiddenLayers.begin(), hiddenLayers.end());
-	layers.push_back(1);
-	learner = {Network(layers)};
+	layers.push_back(output == Block ? patchSize*patchSize : 1);
+	learner = {Network<>(layers)};
+}
+
+void PatchSampler::add(const Image& input, const Image& output) {
+
+	inputs.push_back(input);
+	outputs.push_back(output);
+	firstPatch.push_back(nbPatches);
+	nbPatches += (long long)std::max(input.w - patchSize, 0) * std::max(input.h - patchSize, 0) * input.chans;
+}
+
+PatchSampler::Patch PatchSampler::patch(long long index) const {
+
+	// patches are numbered by image, then row, column and channel
+	int image = int(std::upper_bound(firstPatch.begin(), firstPatch.end(), index) - firstPatch.begin()) - 1;
+	index -= firstPatch[image];
+	const Image& im = inputs[image];
+	int channel = int(index % im.chans);
+	index /= im.chans;
+	int x = int(index % (im.w - patchSize));
+	int y = int(index / (im.w - patchSize));
+	return { image, x, y, channel };
+}
+
+void PatchSampler::sample(int count, bool stratified, std::mt19937& random, std::vector<Patch>& patches) const {
+
+	patches.clear();
+	if (count <= 0 || nbPatches == 0) { return; }
+	if (count >= nbPatches) { // all of them
+		for (long long i = 0; i < nbPatches; i++) { patches.push_back(patch(i)); }
+	}
+	else if (stratified) {
+		for (int k = 0; k < count; k++) {
+			long long first = nbPatches * k / count, last = nbPatches * (k + 1) / count;
+			patches.push_back(patch(first + std::uniform_int_distribution<long long>(0, last - first - 1)(random)));
+		}
+	}
+	else { // reservoir sampling, skipping the patches that won't be kept (algorithm L)
+		std::vector<long long> reservoir(count);
+		for (int k = 0; k < count; k++) { reservoir[k] = k; }
+		std::uniform_real_distribution<double> uniform(0, 1);
+		auto draw = [&] { return std::max(uniform(random), 1E-300); }; // (in ]0;1[)
+		double weight = std::exp(std::log(draw()) / count);
+		for (long long i = count - 1; true;) {
+			i += (long long)(std::log(draw()) / std::log1p(-weight)) + 1;
+			if (i >= nbPatches || i < 0) { break; }
+			reservoir[std::uniform_int_distribution<int>(0, count - 1)(random)] = i;
+			weight *= std::exp(std::log(draw()) / count);
+		}
+		for (long long i : reservoir) { patches.push_back(patch(i)); }
+	}
+	std::shuffle(patches.begin(), patches.end(), random);
+}
+
+void PatchSampler::extract(const Patch& p, uchar* input, double* output) const {
+
+	const Image& src = inputs[p.image];
+	const Image& dst = outputs[p.image];
+	int w = src.w, cols = src.chans;
+	for (int y2 = 0; y2 < patchSize; y2++) {
+		for (int x2 = 0; x2 < patchSize; x2++) {
+			input[y2*patchSize + x2] = src.pixels[cols*((p.y + y2)*w + (p.x + x2)) + p.channel];
+		}
+	}
+	if (!blocks) {
+		*output = dst.pixels[cols*((p.y + patchSize / 2)*w + (p.x + patchSize / 2)) + p.channel] / 255.0;
+		return;
+	}
+	for (int y2 = 0; y2 < patchSize; y2++) {
+		for (int x2 = 0; x2 < patchSize; x2++) {
+			output[y2*patchSize + x2] = dst.pixels[cols*((p.y + y2)*w + (p.x + x2)) + p.channel] / 255.0;
+		}
+	}
+}
+
+// patches learnt at once, in a buffer that is reused
+static const int patchesPerUpdate = 512;
+
+void ImageFilterLearner::learn(const Image& src, const Image& dst, int nbPatches, int epochs, bool stratified) {
+
+	learn(std::vector<Image>{ src }, std::vector<Image>{ dst }, nbPatches, epochs, stratified);
 }
 
-void ImageFilterLearner::learn(const Image& src, const Image& dst) {
+void ImageFilterLearner::learn(const std::vector<Image>& srcs, const std::vector<Image>& dsts, int nbPatches, int epochs, bool stratified) {
 
 	// checking image dimensions
-	int w = src.w, h = src.h, cols = src.chans;
-	if (w != dst.w || h != dst.h || src.chans != dst.chans) {
-		std::cerr << "input and output images have different dimensionrs" << std::endl;
-		throw 1;
+	PatchSampler sampler(patchSize, outputType == Block);
+	for (int i = 0; i < srcs.size(); i++) {
+		const Image& src = srcs[i];
+		const Image& dst = dsts[i];
+		if (src.w != dst.w || src.h != dst.h || src.chans != dst.chans) {
+			std::cerr << "input and output images have different dimensionrs" << std::endl;
+			throw 1;
+		}
+		sampler.add(src, dst); // (assuming independent channels)
 	}
 
-	// getting the image patches (assuming independent channels)
-	int patchSize = 8;
-	std::vector<Sample> samples;;
-	for (int y = 0; y < h - patchSize; y++) {
-		for (int x = 0; x < w - patchSize; x++) {
-			for (int k = 0; k < cols; k++) {
-				Sample s = {
-					std::vector<double>(patchSize*patchSize),
-					std::vector<double>(1)
-				};
-				for (int y2 = 0; y2 < patchSize; y2++) {
-					for (int x2 = 0; x2 < patchSize; x2++) {
-						s.input[y2*patchSize + x2] = src.pixels[cols*((y + y2)*w + (x + x2)) + k] / 255.0;
-						//s.output[y2*patchSize + x2] = dst.pixels[cols*((y + y2)*w + (x + x2)) + k] / 255.0;
-					}
-				}
-				s.output[0] = dst.pixels[cols*((y + patchSize/2)*w + (x + patchSize/2)) + k] / 255.0;
-				samples.push_back(s);
+	// only the drawn patches are extracted, a batch at a time
+	std::mt19937 random(rand());
+	std::vector<PatchSampler::Patch> patches;
+	Dataset<> samples(patchSize*patchSize, sampler.outputSize(), Dataset<>::Bytes); // (pixels scaled to [0;1] when learning)
+	samples.reserve(patchesPerUpdate);
+	std::vector<uchar> input(patchSize*patchSize);
+	std::vector<double> output(sampler.outputSize());
+	for (int e = 0; e < epochs; e++) {
+		sampler.sample(nbPatches, stratified, random, patches);
+		for (int first = 0; first < patches.size(); first += patchesPerUpdate) {
+			samples.clear();
+			for (int i = first; i < std::min<int>(first + patchesPerUpdate, patches.size()); i++) {
+				sampler.extract(patches[i], input.data(), output.data());
+				samples.add(input.data(), output.data());
 			}
+
+			// learning the filter from patches
+			learner.learn(samples);
 		}
 	}
+}
+
+// tiles of the output image, whose patches go through the network at once
+static const int tileSize = 32;
 
-	// HACK : reducing the number of patches
-	std::random_shuffle(samples.begin(), samples.end());
-	samples = std::vector<Sample>(samples.begin(), samples.begin() + 512);
+Image ImageFilterLearner::apply(const Image& src, int stride) {
 
-	// learning the filter from patches
-	learner.learn(samples);
+	if (!pool) { pool = std::make_shared<ThreadPool>(); }
+	if (outputType == Block) { return applyBlocks(src, std::min(std::max(stride, 1), patchSize)); }
+	return applyCenters(src);
 }
 
-Image ImageFilterLearner::apply(const Image& src) {
+Image ImageFilterLearner::applyCenters(const Image& src) {
 
 	int w = src.w, h = src.h, cols = src.chans;
 	Image dst(w, h, cols);
-	
-	// dense patches overlap : we sum them, then average
-	std::vector<double> sums(w*h*cols, 0); // sum of values per pixel
-	std::vector<int> counts(w*h*cols, 0); // number of values added per pixel
-
-										  // applying the filter to each patch
-	for (int y = 0; y < h - patchSize; y ++) {
-		for (int x = 0; x < w - patchSize; x ++) {
-			for (int k = 0; k < cols; k++) {
-
-				// compiling the patch into a column vector
-				std::vector<double> input(patchSize*patchSize);
-				for (int y2 = 0; y2 < patchSize; y2++) {
-					for (int x2 = 0; x2 < patchSize; x2++) {
-						input[y2*patchSize + x2] = src.pixels[cols*((y + y2)*w + (x + x2)) + k] / 255.0;
+	const Network<>& net = learner.net;
+	int half = patchSize / 2;
+
+	// the threads take tiles until there are none left
+	int tilesX = (w + tileSize - 1) / tileSize, tilesY = (h + tileSize - 1) / tileSize;
+	int nbTiles = tilesX * tilesY;
+	if (nbTiles == 0) { return dst; }
+	std::atomic<int> nextTile(0);
+	pool->run(std::min(pool->size(), nbTiles), [&](int) {
+		std::vector<double> inputs(tileSize*tileSize*cols * patchSize*patchSize), outputs(tileSize*tileSize*cols);
+		Network<>::Workspace ws = net.createWorkspace();
+		for (int t = nextTile++; t < nbTiles; t = nextTile++) {
+			int x0 = (t % tilesX) * tileSize, y0 = (t / tilesX) * tileSize;
+			int x1 = std::min(x0 + tileSize, w), y1 = std::min(y0 + tileSize, h);
+
+			// compiling the patches centered on each pixel of the tile into a matrix (the borders are replicated)
+			double* input = inputs.data();
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					for (int k = 0; k < cols; k++) {
+						for (int y2 = 0; y2 < patchSize; y2++) {
+							int srcY = std::min(std::max(y - half + y2, 0), h - 1);
+							for (int x2 = 0; x2 < patchSize; x2++) {
+								int srcX = std::min(std::max(x - half + x2, 0), w - 1);
+								*input++ = src.pixels[cols*(srcY*w + srcX) + k] / 255.0;
+							}
+						}
 					}
 				}
+			}
 
-				// applying the learnt function
-				std::vector<double> output = learner.apply(input);
+			// applying the learnt function to all of them
+			net.applyBatch(inputs.data(), outputs.data(), (y1 - y0)*(x1 - x0)*cols, ws);
 
-				// putting the patch to the destination image
-				/*for (int y2 = 0; y2 < patchSize; y2++) {
-					for (int x2 = 0; x2 < patchSize; x2++) {
-						sums[cols*((y + y2)*w + (x + x2)) + k] += output[y2*patchSize + x2];
-						counts[cols*((y + y2)*w + (x + x2)) + k]++;
+			// the output of a patch is its center pixel
+			const double* output = outputs.data();
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					for (int k = 0; k < cols; k++) {
+						dst.pixels[cols*(y*w + x) + k] = uchar(255.0 * std::min(std::max(*output++, 0.0), 1.0));
 					}
-				}*/
-				sums[cols*((y + patchSize/2)*w + (x + patchSize/2)) + k] += output[0];
-				counts[cols*((y + patchSize / 2)*w + (x + patchSize / 2)) + k]++;
+				}
 			}
 		}
-	}
+	});
+
+	return dst;
+}
+
+// the output tiles of blocks are larger, as the patches overlapping their sides are computed for both tiles
+static const int blockTileSize = 64;
+
+Image ImageFilterLearner::applyBlocks(const Image& src, int stride) {
 
-	// averaging the sums on each pixel
-	for (int i = 0; i < w*h*cols; i++) {
-		if (counts[i] == 0) { continue; } // HACK
-		dst.pixels[i] = 255.0 * sums[i] / counts[i];
+	int w = src.w, h = src.h, cols = src.chans;
+	Image dst(w, h, cols);
+	const Network<>& net = learner.net;
+	int half = patchSize / 2;
+
+	// window blending the overlapping blocks : highest at their centers, and never 0 (sin² of the distance to the sides)
+	std::vector<float> window(patchSize*patchSize);
+	for (int y2 = 0; y2 < patchSize; y2++) {
+		for (int x2 = 0; x2 < patchSize; x2++) {
+			double wy = std::sin(3.14159265358979 * (y2 + 0.5) / patchSize), wx = std::sin(3.14159265358979 * (x2 + 0.5) / patchSize);
+			window[y2*patchSize + x2] = float(wy*wy * wx*wx);
+		}
 	}
 
+	// patches are on a grid of step stride, from -half (centered on the first pixel) to the last pixel
+	// (the borders are replicated) ; position of the patch i : -half + i*stride
+	auto floorDiv = [](int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); };
+	auto firstPatch = [&](int x0) { return std::max(0, floorDiv(x0 - patchSize + half, stride) + 1); }; // first patch ending after x0
+	auto lastPatch = [&](int x1, int size) { return std::min((x1 - 1 + half) / stride, (size - 1 + half) / stride); }; // last starting before x1
+
+	int tilesX = (w + blockTileSize - 1) / blockTileSize, tilesY = (h + blockTileSize - 1) / blockTileSize;
+	int nbTiles = tilesX * tilesY;
+	if (nbTiles == 0) { return dst; }
+	std::atomic<int> nextTile(0);
+	pool->run(std::min(pool->size(), nbTiles), [&](int) {
+		int maxPatches = (blockTileSize + patchSize) / stride + 1;
+		std::vector<double> inputs(maxPatches*maxPatches*cols * patchSize*patchSize), outputs(inputs.size());
+		std::vector<float> sums(blockTileSize*blockTileSize*cols), weights(blockTileSize*blockTileSize); // of the tile
+		Network<>::Workspace ws = net.createWorkspace();
+		for (int t = nextTile++; t < nbTiles; t = nextTile++) {
+			int x0 = (t % tilesX) * blockTileSize, y0 = (t / tilesX) * blockTileSize;
+			int x1 = std::min(x0 + blockTileSize, w), y1 = std::min(y0 + blockTileSize, h);
+			int firstX = firstPatch(x0), lastX = lastPatch(x1, w), firstY = firstPatch(y0), lastY = lastPatch(y1, h);
+
+			// compiling the patches overlapping the tile into a matrix
+			double* input = inputs.data();
+			for (int i = firstY; i <= lastY; i++) {
+				for (int j = firstX; j <= lastX; j++) {
+					int px = -half + j*stride, py = -half + i*stride;
+					for (int k = 0; k < cols; k++) {
+						for (int y2 = 0; y2 < patchSize; y2++) {
+							int srcY = std::min(std::max(py + y2, 0), h - 1);
+							for (int x2 = 0; x2 < patchSize; x2++) {
+								int srcX = std::min(std::max(px + x2, 0), w - 1);
+								*input++ = src.pixels[cols*(srcY*w + srcX) + k] / 255.0;
+							}
+						}
+					}
+				}
+			}
+
+			// applying the learnt function to all of them
+			net.applyBatch(inputs.data(), outputs.data(), (lastY - firstY + 1)*(lastX - firstX + 1)*cols, ws);
+
+			// blending the parts of the blocks inside the tile
+			std::fill(sums.begin(), sums.end(), 0.f);
+			std::fill(weights.begin(), weights.end(), 0.f);
+			const double* output = outputs.data();
+			for (int i = firstY; i <= lastY; i++) {
+				for (int j = firstX; j <= lastX; j++) {
+					int px = -half + j*stride, py = -half + i*stride;
+					for (int k = 0; k < cols; k++, output += patchSize*patchSize) {
+						for (int y2 = std::max(0, y0 - py); y2 < std::min(patchSize, y1 - py); y2++) {
+							for (int x2 = std::max(0, x0 - px); x2 < std::min(patchSize, x1 - px); x2++) {
+								int pixel = (py + y2 - y0)*blockTileSize + (px + x2 - x0);
+								float weight = window[y2*patchSize + x2];
+								sums[pixel*cols + k] += weight * float(output[y2*patchSize + x2]);
+								if (k == 0) { weights[pixel] += weight; }
+							}
+						}
+					}
+				}
+			}
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					int pixel = (y - y0)*blockTileSize + (x - x0);
+					for (int k = 0; k < cols; k++) {
+						float value = sums[pixel*cols + k] / weights[pixel];
+						dst.pixels[cols*(y*w + x) + k] = uchar(255.f * std::min(std::max(value, 0.f), 1.f));
+					}
+				}
+			}
+		}
+	});
+
 	return dst;
-}
\ No newline at end of file
+}
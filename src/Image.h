@@ -3,6 +3,8 @@
 
 #include "Learning.h"
 
+#include <random>
+
 #include <opencv2\opencv.hpp>
 
 // image container
@@ -24,12 +26,48 @@ public:
 		pixels(im.data) {}
 };
 
-// TODO : output size = 1 or patchSize*patchSize ?
+// draws patches among all the patches of pairs of images (input and output), without extracting the others
+class PatchSampler {
+public:
+	struct Patch { int image, x, y, channel; }; // (top left corner, in the input image)
+private:
+	int patchSize;
+	bool blocks; // outputs are the patchSize x patchSize blocks of the output image, instead of their center pixels
+	std::vector<Image> inputs, outputs;
+	std::vector<long long> firstPatch; // index of the first patch of each image
+	long long nbPatches;
+public:
+	PatchSampler(int patchSize, bool blocks = false) : patchSize(patchSize), blocks(blocks), nbPatches(0) {}
+	int outputSize() const { return blocks ? patchSize*patchSize : 1; }
+	void add(const Image& input, const Image& output); // (images of the same dimensions)
+	long long size() const { return nbPatches; } // nb of patches of all images
+	Patch patch(long long index) const;
+
+	// count distinct patches (or all of them if there are fewer), in a random order ; reservoir sampling over all the patches,
+	// or stratified sampling, which draws one patch in each of count equal ranges of the patches
+	void sample(int count, bool stratified, std::mt19937& random, std::vector<Patch>& patches) const;
+
+	// input pixels of the patch (patchSize x patchSize bytes), and its output (outputSize values in [0;1])
+	void extract(const Patch& patch, uchar* input, double* output) const;
+};
+
+// learns a filter from the patches of images
+// the network predicts the center pixel of each patch, or its whole block of pixels (then patches can be applied
+// with a stride, their overlapping blocks being blended : about stride x stride times fewer patches)
 class ImageFilterLearner {
+public:
+	enum Output { CenterPixel, Block };
+private:
 	const int patchSize;
-	NetLearner learner;
+	const Output outputType;
+	NetLearner<> learner;
+	std::shared_ptr<ThreadPool> pool; // of apply, which shares the tiles among its threads
+	Image applyCenters(const Image& input);
+	Image applyBlocks(const Image& input, int stride);
 public:
-	ImageFilterLearner(int patchSize = 8, std::vector<int> hiddenLayers = { 10 });
-	void learn(const Image& input, const Image& output);
-	Image apply(const Image& input);
-};
\ No newline at end of file
+	ImageFilterLearner(int patchSize = 8, std::vector<int> hiddenLayers = { 10 }, Output output = CenterPixel);
+	// learns nbPatches random patches of the images at each epoch, streamed in batches of patchesPerUpdate
+	void learn(const Image& input, const Image& output, int nbPatches = 512, int epochs = 1, bool stratified = false);
+	void learn(const std::vector<Image>& inputs, const std::vector<Image>& outputs, int nbPatches = 512, int epochs = 1, bool stratified = false);
+	Image apply(const Image& input, int stride = 1); // (the stride, in [1;patchSize], is only used for blocks)
+};
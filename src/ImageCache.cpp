@@ -0,0 +1,178 @@
+#include "ImageCache.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+static const uint32_t cacheMagic = 0x43474D49; // "IMGC" in the file
+static const uint32_t cacheVersion = 1;
+static const size_t cacheAlignment = 64; // of the blocks (the header takes the first one)
+
+static size_t alignedOffset(size_t offset) { return (offset + cacheAlignment - 1) / cacheAlignment * cacheAlignment; }
+
+static uint32_t readUint32(const unsigned char* src) {
+
+	return uint32_t(src[0]) | (uint32_t(src[1]) << 8) | (uint32_t(src[2]) << 16) | (uint32_t(src[3]) << 24);
+}
+
+static void storeUint32(unsigned char* dst, uint32_t value) {
+
+	for (int i = 0; i < 4; i++) { dst[i] = (unsigned char)(value >> (8 * i)); }
+}
+
+// FNV-1a (64 bits), computed while streaming
+static const uint64_t checksumSeed = 0xCBF29CE484222325ull;
+static uint64_t updateChecksum(uint64_t hash, const unsigned char* data, size_t size) {
+
+	for (size_t i = 0; i < size; i++) { hash = (hash ^ data[i]) * 0x100000001B3ull; }
+	return hash;
+}
+
+ImageCache::ImageCache(const std::string& fileName, bool verify) : file(std::make_shared<MappedFile>(fileName)) {
+
+	const unsigned char* src = file->data();
+	size_t fileSize = file->size();
+	if (fileSize < cacheAlignment || readUint32(src) != cacheMagic) { throw std::runtime_error(fileName + " is not an image cache"); }
+	if (readUint32(src + 4) != cacheVersion) { throw std::runtime_error(fileName + " has an unsupported version"); }
+	count = int(readUint32(src + 8));
+	w = int(readUint32(src + 12));
+	h = int(readUint32(src + 16));
+	nbChannels = int(readUint32(src + 20));
+	uint32_t type = readUint32(src + 24);
+	if (count < 0 || w <= 0 || h <= 0 || nbChannels <= 0 || type > ClassLabels) { throw std::runtime_error(fileName + " has an invalid header"); }
+	labelType = LabelType(type);
+	uint64_t checksum = readUint32(src + 32) | (uint64_t(readUint32(src + 36)) << 32);
+
+	labelsOffset = alignedOffset(cacheAlignment + count * imageSize());
+	size_t offset = alignedOffset(labelsOffset + (labelType == ClassLabels ? 4 * size_t(count) : 0));
+	keyOffsets.resize(count);
+	for (int i = 0; i < count; i++) {
+		if (offset + 4 > fileSize) { throw std::runtime_error(fileName + " is truncated"); }
+		keyOffsets[i] = offset;
+		offset += 4 + readUint32(src + offset);
+	}
+	if (offset > fileSize) { throw std::runtime_error(fileName + " is truncated"); }
+
+	if (verify && updateChecksum(checksumSeed, src + cacheAlignment, offset - cacheAlignment) != checksum) {
+		throw std::runtime_error(fileName + " is corrupted");
+	}
+}
+
+int ImageCache::label(int i) const {
+
+	if (labelType == NoLabels) { return 0; }
+	return int32_t(readUint32(file->data() + labelsOffset + 4 * size_t(i)));
+}
+
+std::string ImageCache::key(int i) const {
+
+	const unsigned char* src = file->data() + keyOffsets[i];
+	return std::string((const char*)src + 4, readUint32(src));
+}
+
+std::string ImageCache::sourceKey(const std::string& path) {
+
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) { return ""; }
+	return path + '|' + std::to_string((long long)st.st_size) + '|' + std::to_string((long long)st.st_mtime);
+}
+
+ImageCacheWriter::ImageCacheWriter(const std::string& fileName, int width, int height, int channels, ImageCache::LabelType labelType) :
+	fileName(fileName), tempName(fileName + ".tmp"), count(0), w(width), h(height), nbChannels(channels), labelType(labelType),
+	checksum(checksumSeed), offset(0) {
+
+	// the previous version of the cache, if it is valid and has the same layout
+	try {
+		previous.reset(new ImageCache(fileName));
+		if (previous->width() != w || previous->height() != h || previous->channels() != nbChannels || previous->getLabelType() != labelType) {
+			previous.reset();
+		}
+		else {
+			for (int i = 0; i < previous->size(); i++) { previousKeys[previous->key(i)] = i; }
+		}
+	}
+	catch (const std::runtime_error&) { previous.reset(); }
+
+	dst.open(tempName, std::ios::out | std::ios::binary);
+	if (!dst.is_open()) { throw std::runtime_error("can't write " + tempName); }
+	static const char header[cacheAlignment] = {}; // (written by finish)
+	dst.write(header, cacheAlignment);
+	offset = cacheAlignment;
+}
+
+ImageCacheWriter::~ImageCacheWriter() {
+
+	if (dst.is_open()) { dst.close(); std::remove(tempName.c_str()); }
+}
+
+void ImageCacheWriter::write(const void* data, size_t size) {
+
+	dst.write((const char*)data, size);
+	checksum = updateChecksum(checksum, (const unsigned char*)data, size);
+	offset += size;
+}
+
+void ImageCacheWriter::writePadding() {
+
+	static const unsigned char zeros[cacheAlignment] = {};
+	write(zeros, alignedOffset(offset) - offset);
+}
+
+void ImageCacheWriter::add(const unsigned char* pixels, int label, const std::string& key) {
+
+	write(pixels, size_t(w) * h * nbChannels);
+	labels.push_back(label);
+	keys.push_back(key);
+	count++;
+}
+
+bool ImageCacheWriter::addCached(const std::string& key) {
+
+	if (!previous || key.empty()) { return false; }
+	auto found = previousKeys.find(key);
+	if (found == previousKeys.end()) { return false; }
+	add(previous->pixels(found->second), previous->label(found->second), key);
+	return true;
+}
+
+void ImageCacheWriter::finish() {
+
+	writePadding();
+	if (labelType == ImageCache::ClassLabels) {
+		for (int32_t label : labels) {
+			unsigned char bytes[4]; storeUint32(bytes, uint32_t(label));
+			write(bytes, 4);
+		}
+		writePadding();
+	}
+	for (const std::string& key : keys) {
+		unsigned char length[4]; storeUint32(length, uint32_t(key.size()));
+		write(length, 4);
+		write(key.data(), key.size());
+	}
+
+	unsigned char header[cacheAlignment] = {};
+	uint32_t fields[] = { cacheMagic, cacheVersion, uint32_t(count), uint32_t(w), uint32_t(h), uint32_t(nbChannels), uint32_t(labelType), 0,
+		uint32_t(checksum), uint32_t(checksum >> 32) };
+	for (int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) { storeUint32(header + 4 * i, fields[i]); }
+	dst.seekp(0);
+	dst.write((const char*)header, cacheAlignment);
+	bool good = dst.good();
+	dst.close();
+	if (!good) { std::remove(tempName.c_str()); throw std::runtime_error("can't write " + tempName); }
+
+	// replacing the previous version (which must be unmapped first) at once : there is always a complete cache file
+	previous.reset();
+	previousKeys.clear();
+#ifdef _WIN32
+	bool renamed = MoveFileExA(tempName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0; // (rename doesn't replace)
+#else
+	bool renamed = std::rename(tempName.c_str(), fileName.c_str()) == 0;
+#endif
+	if (!renamed) { throw std::runtime_error("can't write " + fileName); }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+// cache of an image dataset (all images resized to the same dimensions), mapped in memory :
+// a header (magic, version, count, width, height, channels, label type, checksum), then 64-byte aligned blocks of
+// all the pixels (count x width x height x channels bytes), of the labels (int32) and of the source keys of the samples
+// (all little-endian ; the checksum covers everything after the header)
+class ImageCache
+{
+public:
+	enum LabelType { NoLabels, ClassLabels };
+
+private:
+	std::shared_ptr<MappedFile> file;
+	int count, w, h, nbChannels;
+	LabelType labelType;
+	size_t labelsOffset;
+	std::vector<size_t> keyOffsets; // of each source key in the file
+
+public:
+	// throws std::runtime_error if the file can't be mapped, isn't a valid cache or (with verify) is corrupted
+	ImageCache(const std::string& fileName, bool verify = true);
+
+	int size() const { return count; }
+	int width() const { return w; }
+	int height() const { return h; }
+	int channels() const { return nbChannels; }
+	LabelType getLabelType() const { return labelType; }
+	size_t imageSize() const { return size_t(w) * h * nbChannels; } // in bytes
+
+	// random access, in the file
+	const unsigned char* pixels(int i) const { return file->data() + 64 + i * imageSize(); }
+	int label(int i) const; // (0 without labels)
+	std::string key(int i) const;
+
+	// path, size and modification time of a source file (empty if it doesn't exist) : a sample is rebuilt when it changes
+	static std::string sourceKey(const std::string& path);
+};
+
+// builds a cache file by streaming the samples to it ; the file is replaced when the cache is finished
+// samples whose source key is in the previous version of the cache (with the same dimensions) can be copied from it
+class ImageCacheWriter
+{
+	std::string fileName, tempName;
+	std::ofstream dst;
+	int count, w, h, nbChannels;
+	ImageCache::LabelType labelType;
+	std::vector<int32_t> labels;
+	std::vector<std::string> keys;
+	uint64_t checksum;
+	size_t offset;
+	std::unique_ptr<ImageCache> previous;
+	std::unordered_map<std::string, int> previousKeys;
+
+	void write(const void* data, size_t size);
+	void writePadding();
+
+public:
+	// throws std::runtime_error if the file can't be written
+	ImageCacheWriter(const std::string& fileName, int width, int height, int channels, ImageCache::LabelType labelType);
+	~ImageCacheWriter(); // (an unfinished cache is discarded)
+	ImageCacheWriter(const ImageCacheWriter&) = delete;
+	ImageCacheWriter& operator=(const ImageCacheWriter&) = delete;
+
+	int size() const { return count; }
+	void add(const unsigned char* pixels, int label = 0, const std::string& key = "");
+	bool addCached(const std::string& key); // false if the key isn't in the previous cache
+	bool hasCached(const std::string& key) const { return !key.empty() && previousKeys.count(key) > 0; } // (thread-safe)
+	void finish(); // throws std::runtime_error if the file can't be written
+};
@@ -17,7 +17,7 @@ void learnImage(std::string fileName) {
 	int cols = src.channels();
 
 	// fetching the sample pixels
-	std::vector<Sample> samples(w*h);
+	std::vector<Sample<>> samples(w*h);
 	for (int y = 0; y < h; y++) {
 		for (int x = 0; x < w; x++) {
 			std::vector<double> colors(cols);
@@ -32,21 +32,31 @@ void learnImage(std::string fileName) {
 	}
 
 	// learning
-	NetLearner learner(Network({ 2, 10, 10, cols }));
+	NetLearner<> learner(Network<>({ 2, 10, 10, cols }));
 	learner.learn(samples);
 
 	// getting the output of the learnt function
 	int dstSize = 512;
 	cv::Mat dst(cv::Size(dstSize, dstSize), CV_8UC4);
+	std::vector<double> coords(2 * dstSize*dstSize), results(cols * dstSize*dstSize);
 	for (int y = 0; y < dstSize; y++) {
 		for (int x = 0; x < dstSize; x++) {
-			std::vector<double> result = learner.apply({
-				(x*1.0) / dstSize,
-				(y*1.0) / dstSize
-			});
-			for (int c = 0; c < cols; c++) {
-				dst.data[4 * (y*dstSize + x) + c] = (uchar)(255 * result[c]);
-			}
+			coords[2 * (y*dstSize + x)] = (x*1.0) / dstSize;
+			coords[2 * (y*dstSize + x) + 1] = (y*1.0) / dstSize;
+		}
+	}
+	learner.applyBatch(coords.data(), results.data(), dstSize*dstSize);
+#if 0	// the nearest pixels instead (their coordinates are indexed in a KD-tree)
+	KNearestNeighbors neighbors(4);
+	neighbors.learn(samples);
+	for (int i = 0; i < dstSize*dstSize; i++) {
+		std::vector<double> colors = neighbors.apply({ coords[2 * i], coords[2 * i + 1] });
+		std::copy(colors.begin(), colors.end(), results.begin() + cols * i);
+	}
+#endif
+	for (int i = 0; i < dstSize*dstSize; i++) {
+		for (int c = 0; c < cols; c++) {
+			dst.data[4 * i + c] = (uchar)(255 * results[cols*i + c]);
 		}
 	}
 	cv::imshow("Learnt image", dst); cv::waitKey();
@@ -116,7 +126,14 @@ void learnImage() {
 		);
 	if (!video.isOpened()) { std::cerr << "can't open " << videoFileName << std::endl; return; }
 
-	NetLearner learner(Network({ 2, 3, 3, 3 }));
+	NetLearner<> learner(Network<>({ 2, 3, 3, 3 }));
+	std::vector<double> coords(2 * dstSize*dstSize), results(3 * dstSize*dstSize);
+	for (int y = 0; y < dstSize; y++) {
+		for (int x = 0; x < dstSize; x++) {
+			coords[2 * (y*dstSize + x)] = (x*1.0) / dstSize;
+			coords[2 * (y*dstSize + x) + 1] = (y*1.0) / dstSize;
+		}
+	}
 
 	for (std::string fileName : {
 		"../../data/blender.png",
@@ -135,7 +152,7 @@ void learnImage() {
 		int cols = src.channels();
 
 		// fetching the sample pixels
-		std::vector<Sample> samples(w*h);
+		std::vector<Sample<>> samples(w*h);
 		for (int y = 0; y < h; y++) {
 			for (int x = 0; x < w; x++) {
 				std::vector<double> colors(cols);
@@ -155,15 +172,10 @@ void learnImage() {
 
 			// getting the output of the learnt function
 			cv::Mat dst(cv::Size(dstSize, dstSize), CV_8UC3);
-			for (int y = 0; y < dstSize; y++) {
-				for (int x = 0; x < dstSize; x++) {
-					std::vector<double> result = learner.apply({
-						(x*1.0) / dstSize,
-						(y*1.0) / dstSize
-					});
-					for (int c = 0; c < max(cols, 3); c++) {
-						dst.data[3 * (y*dstSize + x) + c] = (uchar)(255 * result[c]);
-					}
+			learner.applyBatch(coords.data(), results.data(), dstSize*dstSize);
+			for (int i = 0; i < dstSize*dstSize; i++) {
+				for (int c = 0; c < max(cols, 3); c++) {
+					dst.data[3 * i + c] = (uchar)(255 * results[3 * i + c]);
 				}
 			}
 			cv::imshow("Learnt image", dst); cv::waitKey(1);
@@ -0,0 +1,498 @@
+#include "Kernels.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define KERNEL_TARGET(isa) // MSVC accepts any intrinsic in any function
+#else
+#include <cpuid.h>
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace Kernels {
+
+	// scalar kernels : same operation order as the plain loops, so the results are bit-comparable
+
+	template<typename Acc, typename T>
+	static Acc dotScalar(const T* a, const T* b, int n) {
+
+		Acc sum = 0;
+		for (int i = 0; i < n; i++) { sum += Acc(a[i]) * b[i]; }
+		return sum;
+	}
+
+	template<typename A, typename X, typename Y>
+	static void axpyScalar(A alpha, const X* x, Y* y, int n) {
+
+		for (int i = 0; i < n; i++) { y[i] += alpha * x[i]; }
+	}
+
+	template<typename T>
+	static void sigmoidScalar(const T* x, T* y, int n) {
+
+		for (int i = 0; i < n; i++) { y[i] = 1 / (1 + exp(-x[i])); }
+	}
+
+#ifdef KERNELS_X86
+
+	KERNEL_TARGET("sse2")
+	static double dotSSE2(const double* a, const double* b, int n) {
+
+		__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+		int i = 0;
+		for (; i + 4 <= n; i += 4) {
+			s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+			s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+		}
+		s0 = _mm_add_pd(s0, s1);
+		double sums[2]; _mm_storeu_pd(sums, s0);
+		double sum = sums[0] + sums[1];
+		for (; i < n; i++) { sum += a[i] * b[i]; }
+		return sum;
+	}
+
+	KERNEL_TARGET("sse2")
+	static void axpySSE2(double alpha, const double* x, double* y, int n) {
+
+		__m128d a = _mm_set1_pd(alpha);
+		int i = 0;
+		for (; i + 2 <= n; i += 2) {
+			_mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(a, _mm_loadu_pd(x + i))));
+		}
+		for (; i < n; i++) { y[i] += alpha * x[i]; }
+	}
+
+	KERNEL_TARGET("avx2,fma")
+	static double dotAVX2(const double* a, const double* b, int n) {
+
+		__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+			s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), s1);
+		}
+		for (; i + 4 <= n; i += 4) {
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+		}
+		s0 = _mm256_add_pd(s0, s1);
+		__m128d s = _mm_add_pd(_mm256_castpd256_pd128(s0), _mm256_extractf128_pd(s0, 1));
+		double sums[2]; _mm_storeu_pd(sums, s);
+		double sum = sums[0] + sums[1];
+		for (; i < n; i++) { sum += a[i] * b[i]; }
+		return sum;
+	}
+
+	KERNEL_TARGET("avx2,fma")
+	static void axpyAVX2(double alpha, const double* x, double* y, int n) {
+
+		__m256d a = _mm256_set1_pd(alpha);
+		int i = 0;
+		for (; i + 4 <= n; i += 4) {
+			_mm256_storeu_pd(y + i, _mm256_fmadd_pd(a, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		}
+		for (; i < n; i++) { y[i] += alpha * x[i]; }
+	}
+
+	KERNEL_TARGET("avx512f")
+	static double dotAVX512(const double* a, const double* b, int n) {
+
+		__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+			s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), s1);
+		}
+		for (; i + 8 <= n; i += 8) {
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+		}
+		s0 = _mm512_add_pd(s0, s1);
+		// halves added through memory (GCC's wrappers of the 512 -> 256 bits extractions read an uninitialized register)
+		double sums[8]; _mm512_storeu_pd(sums, s0);
+		double sum = ((sums[0] + sums[4]) + (sums[2] + sums[6])) + ((sums[1] + sums[5]) + (sums[3] + sums[7]));
+		for (; i < n; i++) { sum += a[i] * b[i]; }
+		return sum;
+	}
+
+	KERNEL_TARGET("avx512f")
+	static void axpyAVX512(double alpha, const double* x, double* y, int n) {
+
+		__m512d a = _mm512_set1_pd(alpha);
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			_mm512_storeu_pd(y + i, _mm512_fmadd_pd(a, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+		}
+		for (; i < n; i++) { y[i] += alpha * x[i]; }
+	}
+
+	KERNEL_TARGET("sse2")
+	static float dotSSE2(const float* a, const float* b, int n) {
+
+		__m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+			s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+		}
+		s0 = _mm_add_ps(s0, s1);
+		float sums[4]; _mm_storeu_ps(sums, s0);
+		float sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+		for (; i < n; i++) { sum += a[i] * b[i]; }
+		return sum;
+	}
+
+	KERNEL_TARGET("sse2")
+	static void axpySSE2(float alpha, const float* x, float* y, int n) {
+
+		__m128 a = _mm_set1_ps(alpha);
+		int i = 0;
+		for (; i + 4 <= n; i += 4) {
+			_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(a, _mm_loadu_ps(x + i))));
+		}
+		for (; i < n; i++) { y[i] += alpha * x[i]; }
+	}
+
+	KERNEL_TARGET("avx2,fma")
+	static float dotAVX2(const float* a, const float* b, int n) {
+
+		__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+			s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+		}
+		for (; i + 8 <= n; i += 8) {
+			s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+		}
+		s0 = _mm256_add_ps(s0, s1);
+		__m128 s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+		float sums[4]; _mm_storeu_ps(sums, s);
+		float sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+		for (; i < n; i++) { sum += a[i] * b[i]; }
+		return sum;
+	}
+
+	KERNEL_TARGET("avx2,fma")
+	static void axpyAVX2(float alpha, const float* x, float* y, int n) {
+
+		__m256 a = _mm256_set1_ps(alpha);
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			_mm256_storeu_ps(y + i, _mm256_fmadd_ps(a, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+		}
+		for (; i < n; i++) { y[i] += alpha * x[i]; }
+	}
+
+	// floats converted to doubles before the products
+	KERNEL_TARGET("avx2,fma")
+	static double dotMixedAVX2(const float* a, const float* b, int n) {
+
+		__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			s0 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(a + i)), _mm256_cvtps_pd(_mm_loadu_ps(b + i)), s0);
+			s1 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(a + i + 4)), _mm256_cvtps_pd(_mm_loadu_ps(b + i + 4)), s1);
+		}
+		s0 = _mm256_add_pd(s0, s1);
+		__m128d s = _mm_add_pd(_mm256_castpd256_pd128(s0), _mm256_extractf128_pd(s0, 1));
+		double sums[2]; _mm_storeu_pd(sums, s);
+		double sum = sums[0] + sums[1];
+		for (; i < n; i++) { sum += double(a[i]) * b[i]; }
+		return sum;
+	}
+
+	KERNEL_TARGET("avx512f")
+	static float dotAVX512(const float* a, const float* b, int n) {
+
+		__m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+		int i = 0;
+		for (; i + 32 <= n; i += 32) {
+			s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+			s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), s1);
+		}
+		for (; i + 16 <= n; i += 16) {
+			s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+		}
+		s0 = _mm512_add_ps(s0, s1);
+		float sums[16]; _mm512_storeu_ps(sums, s0);
+		float sum = 0;
+		for (int j = 0; j < 16; j++) { sum += sums[j]; }
+		for (; i < n; i++) { sum += a[i] * b[i]; }
+		return sum;
+	}
+
+	KERNEL_TARGET("avx512f")
+	static void axpyAVX512(float alpha, const float* x, float* y, int n) {
+
+		__m512 a = _mm512_set1_ps(alpha);
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			_mm512_storeu_ps(y + i, _mm512_fmadd_ps(a, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+		}
+		for (; i < n; i++) { y[i] += alpha * x[i]; }
+	}
+
+	KERNEL_TARGET("avx512f")
+	static double dotMixedAVX512(const float* a, const float* b, int n) {
+
+		__m512d s0 = _mm512_setzero_pd();
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			// (the zero-masked conversion : GCC's wrapper of the unmasked one reads an uninitialized register)
+			s0 = _mm512_fmadd_pd(_mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(a + i)), _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(b + i)), s0);
+		}
+		double sums[8]; _mm512_storeu_pd(sums, s0);
+		double sum = 0;
+		for (int j = 0; j < 8; j++) { sum += sums[j]; }
+		for (; i < n; i++) { sum += double(a[i]) * b[i]; }
+		return sum;
+	}
+
+	// exp(x) = 2^k * exp(r), with k = round(x / ln2) and |r| <= ln2 / 2 : exp(r) by its Taylor polynomial
+	// (ln2 is split in a high and a low part, so that r is exact)
+
+	KERNEL_TARGET("avx2,fma")
+	static __m256d expAVX2(__m256d x) {
+
+		x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-708)), _mm256_set1_pd(708)); // 2^k stays a normal double
+		__m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(6.93145751953125E-1), x);
+		r = _mm256_fnmadd_pd(k, _mm256_set1_pd(1.42860682030941723212E-6), r);
+		__m256d p = _mm256_set1_pd(1.0 / 479001600); // 1/12!
+		const double coeffs[] = { 1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880, 1.0 / 40320, 1.0 / 5040, 1.0 / 720,
+			1.0 / 120, 1.0 / 24, 1.0 / 6, 0.5, 1, 1 };
+		for (double c : coeffs) { p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(c)); }
+		__m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+		e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52); // 2^k
+		return _mm256_mul_pd(p, _mm256_castsi256_pd(e));
+	}
+
+	KERNEL_TARGET("avx2,fma")
+	static __m256 expAVX2(__m256 x) {
+
+		x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87)), _mm256_set1_ps(87));
+		__m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(0.693359375f), x);
+		r = _mm256_fnmadd_ps(k, _mm256_set1_ps(-2.12194440e-4f), r);
+		__m256 p = _mm256_set1_ps(1.0f / 5040);
+		const float coeffs[] = { 1.0f / 720, 1.0f / 120, 1.0f / 24, 1.0f / 6, 0.5f, 1, 1 };
+		for (float c : coeffs) { p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(c)); }
+		__m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+		return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+	}
+
+	KERNEL_TARGET("avx2,fma")
+	static void sigmoidAVX2(const double* x, double* y, int n) {
+
+		__m256d one = _mm256_set1_pd(1);
+		int i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m256d e = expAVX2(_mm256_sub_pd(_mm256_setzero_pd(), _mm256_loadu_pd(x + i)));
+			_mm256_storeu_pd(y + i, _mm256_div_pd(one, _mm256_add_pd(one, e)));
+		}
+		sigmoidScalar(x + i, y + i, n - i);
+	}
+
+	KERNEL_TARGET("avx2,fma")
+	static void sigmoidAVX2(const float* x, float* y, int n) {
+
+		__m256 one = _mm256_set1_ps(1);
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 e = expAVX2(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(x + i)));
+			_mm256_storeu_ps(y + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+		}
+		sigmoidScalar(x + i, y + i, n - i);
+	}
+
+	static void cpuid(int leaf, int subLeaf, unsigned int regs[4]) {
+
+#ifdef _MSC_VER
+		int r[4]; __cpuidex(r, leaf, subLeaf);
+		for (int i = 0; i < 4; i++) { regs[i] = r[i]; }
+#else
+		__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	// register state saved by the OS on context switches (XCR0)
+	static unsigned long long xgetbv() {
+
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((unsigned long long)edx << 32) | eax;
+#endif
+	}
+
+	Isa detectIsa() {
+
+		unsigned int regs[4]; // eax, ebx, ecx, edx
+		cpuid(0, 0, regs);
+		unsigned int maxLeaf = regs[0];
+
+		cpuid(1, 0, regs);
+		bool sse2 = (regs[3] >> 26) & 1;
+		bool osxsave = (regs[2] >> 27) & 1;
+		bool avx = (regs[2] >> 28) & 1;
+		bool fma = (regs[2] >> 12) & 1;
+		if (!sse2) { return Scalar; }
+		if (!osxsave || !avx) { return SSE2; }
+
+		unsigned long long xcr0 = xgetbv();
+		if ((xcr0 & 0x6) != 0x6 || maxLeaf < 7) { return SSE2; } // YMM registers not saved by the OS
+
+		cpuid(7, 0, regs);
+		bool avx2 = (regs[1] >> 5) & 1;
+		bool avx512f = (regs[1] >> 16) & 1;
+		// (the AVX-512 table keeps the AVX2 sigmoid, built with FMA)
+		if (avx512f && avx2 && fma && (xcr0 & 0xE6) == 0xE6) { return AVX512; }
+		if (avx2 && fma) { return AVX2; }
+		return SSE2;
+	}
+
+#else
+
+	Isa detectIsa() { return Scalar; }
+
+#endif
+
+	struct Table
+	{
+		Isa isa;
+		double(*dotD)(const double*, const double*, int);
+		float(*dotF)(const float*, const float*, int);
+		double(*dotFD)(const float*, const float*, int);
+		void(*axpyD)(double, const double*, double*, int);
+		void(*axpyF)(float, const float*, float*, int);
+		void(*sigmoidD)(const double*, double*, int);
+		void(*sigmoidF)(const float*, float*, int);
+	};
+
+	// immutable tables, one per instruction set
+	static const Table& tableFor(Isa isa) {
+
+#ifdef KERNELS_X86
+		static const Table avx512 = { AVX512, dotAVX512, dotAVX512, dotMixedAVX512, axpyAVX512, axpyAVX512,
+			sigmoidAVX2, sigmoidAVX2 }; // (the exp is bound by the divisions, not by the register width)
+		static const Table avx2 = { AVX2, dotAVX2, dotAVX2, dotMixedAVX2, axpyAVX2, axpyAVX2, sigmoidAVX2, sigmoidAVX2 };
+		static const Table sse2 = { SSE2, dotSSE2, dotSSE2, dotScalar<double, float>, axpySSE2, axpySSE2,
+			sigmoidScalar<double>, sigmoidScalar<float> };
+#endif
+		static const Table scalar = { Scalar, dotScalar<double, double>, dotScalar<float, float>, dotScalar<double, float>,
+			axpyScalar<double, double, double>, axpyScalar<float, float, float>, sigmoidScalar<double>, sigmoidScalar<float> };
+
+		switch (isa) {
+#ifdef KERNELS_X86
+		case AVX512: return avx512;
+		case AVX2: return avx2;
+		case SSE2: return sse2;
+#endif
+		default: return scalar;
+		}
+	}
+
+	// the table in use : setIsa switches it atomically, while kernels may be running on other threads
+	static std::atomic<const Table*>& current() {
+
+		static std::atomic<const Table*> t(&tableFor(detectIsa()));
+		return t;
+	}
+
+	static const Table& table() { return *current().load(std::memory_order_acquire); }
+
+	Isa isa() { return table().isa; }
+
+	void setIsa(Isa isa) {
+
+		if (isa > detectIsa()) { isa = detectIsa(); } // can't run instructions that the host doesn't have
+		current().store(&tableFor(isa), std::memory_order_release);
+	}
+
+	const char* isaName(Isa isa) {
+
+		switch (isa) {
+		case SSE2: return "SSE2";
+		case AVX2: return "AVX2";
+		case AVX512: return "AVX-512";
+		default: return "Scalar";
+		}
+	}
+
+	template<> double dot<double, double>(const double* a, const double* b, int n) { return table().dotD(a, b, n); }
+	template<> float dot<float, float>(const float* a, const float* b, int n) { return table().dotF(a, b, n); }
+	template<> double dot<double, float>(const float* a, const float* b, int n) { return table().dotFD(a, b, n); }
+
+	void axpy(double alpha, const double* x, double* y, int n) { table().axpyD(alpha, x, y, n); }
+	void axpy(float alpha, const float* x, float* y, int n) { table().axpyF(alpha, x, y, n); }
+	void axpy(double alpha, const float* x, double* y, int n) { axpyScalar(alpha, x, y, n); }
+	void axpy(double alpha, const double* x, float* y, int n) { axpyScalar(alpha, x, y, n); }
+
+	// relaxed atomic accesses to plain values (C++14 has no atomic_ref)
+	template<typename T>
+	static T relaxedLoad(const T* p) {
+
+#ifdef _MSC_VER
+		return *(const volatile T*)p; // (aligned accesses up to 8 bytes are atomic on the targets of MSVC)
+#else
+		T value;
+		__atomic_load(p, &value, __ATOMIC_RELAXED);
+		return value;
+#endif
+	}
+
+	template<typename T>
+	static void relaxedStore(T* p, T value) {
+
+#ifdef _MSC_VER
+		*(volatile T*)p = value;
+#else
+		__atomic_store(p, &value, __ATOMIC_RELAXED);
+#endif
+	}
+
+	template<typename T>
+	static void sharedAxpyT(T alpha, const T* x, const int* indices, int count, T* y) {
+
+		for (int k = 0; k < count; k++) {
+			int i = indices[k];
+			relaxedStore(y + i, relaxedLoad(y + i) + alpha * x[i]);
+		}
+	}
+
+	void sharedAxpy(double alpha, const double* x, const int* indices, int count, double* y) { sharedAxpyT(alpha, x, indices, count, y); }
+	void sharedAxpy(float alpha, const float* x, const int* indices, int count, float* y) { sharedAxpyT(alpha, x, indices, count, y); }
+	void sharedAdd(double value, double* y) { relaxedStore(y, relaxedLoad(y) + value); }
+	void sharedAdd(float value, float* y) { relaxedStore(y, relaxedLoad(y) + value); }
+
+	void sigmoid(const double* x, double* y, int n) { table().sigmoidD(x, y, n); }
+	void sigmoid(const float* x, float* y, int n) { table().sigmoidF(x, y, n); }
+
+	void* alignedAlloc(size_t size) {
+
+#ifdef _MSC_VER
+		return _aligned_malloc(size, alignment);
+#else
+		void* p = NULL;
+		if (posix_memalign(&p, alignment, size) != 0) { return NULL; }
+		return p;
+#endif
+	}
+
+	void alignedFree(void* p) {
+
+#ifdef _MSC_VER
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+}
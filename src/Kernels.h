@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// vector kernels of the inner loops, with SSE2 / AVX2 / AVX-512 variants
+// the best variant supported by the host is picked at startup (from CPUID)
+namespace Kernels {
+
+	enum Isa { Scalar, SSE2, AVX2, AVX512 };
+
+	Isa detectIsa(); // best instruction set supported by the CPU and the OS
+	Isa isa(); // instruction set currently used by the kernels
+	// forces an instruction set (Scalar gives the same results as plain loops) ; safe while kernels run on other threads
+	// (each call uses one of the tables, whole), but their results then mix both instruction sets
+	void setIsa(Isa isa);
+	const char* isaName(Isa isa);
+
+	const int alignment = 64; // in bytes : the width of the largest registers (AVX-512)
+
+	// rounds n up to a whole number of registers, so that padded rows can be processed without tails
+	inline int paddedSize(int n, int elemSize) {
+		int width = alignment / elemSize;
+		return ((n + width - 1) / width) * width;
+	}
+
+	// returns sum( a[i] * b[i] ), accumulated in the Acc type (eg: dot<double>(floats) for mixed precision)
+	template<typename Acc, typename T> Acc dot(const T* a, const T* b, int n);
+	template<> double dot<double, double>(const double* a, const double* b, int n);
+	template<> float dot<float, float>(const float* a, const float* b, int n);
+	template<> double dot<double, float>(const float* a, const float* b, int n);
+
+	// y += alpha * x
+	void axpy(double alpha, const double* x, double* y, int n);
+	void axpy(float alpha, const float* x, float* y, int n);
+	void axpy(double alpha, const float* x, double* y, int n); // accumulating floats in double precision
+	void axpy(double alpha, const double* x, float* y, int n);
+
+	// y[i] += alpha * x[i] for the indices, and *y += value : for values updated by several threads without locks (Hogwild),
+	// with relaxed atomic loads and stores (an update may be lost, but a value is always read and written whole)
+	// (the other threads read these values in the kernels above, called through the dispatch table)
+	void sharedAxpy(double alpha, const double* x, const int* indices, int count, double* y);
+	void sharedAxpy(float alpha, const float* x, const int* indices, int count, float* y);
+	void sharedAdd(double value, double* y);
+	void sharedAdd(float value, float* y);
+
+	// y = 1 / (1 + exp(-x)) ; the vector variants use a polynomial exp, within a few ulps of the scalar one
+	// (x and y may be the same array)
+	void sigmoid(const double* x, double* y, int n);
+	void sigmoid(const float* x, float* y, int n);
+
+	// A (m x n) += alpha * x * y^T
+	template<typename T, typename Acc>
+	void rank1(Acc alpha, const T* x, int m, const T* y, int n, Acc* A, int lda) {
+		for (int i = 0; i < m; i++) {
+			if (x[i] == 0) { continue; }
+			axpy(alpha * x[i], y, A + i*lda, n);
+		}
+	}
+
+	void* alignedAlloc(size_t size);
+	void alignedFree(void* p);
+}
+
+// allocator for buffers aligned to Kernels::alignment
+template<typename T>
+struct AlignedAllocator
+{
+	typedef T value_type;
+
+	AlignedAllocator() {}
+	template<typename U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+	T* allocate(size_t n) {
+		void* p = Kernels::alignedAlloc(n * sizeof(T));
+		if (p == NULL) { throw std::bad_alloc(); }
+		return (T*)p;
+	}
+	void deallocate(T* p, size_t) { Kernels::alignedFree(p); }
+
+	template<typename U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+	template<typename U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
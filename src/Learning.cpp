@@ -1,106 +1,299 @@
 #include "Learning.h"
 
-double NetLearner::learn(const std::vector<Sample>& samples, int iterations, int miniBatch, double learningRate) {
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 
-	double error;
-	for (int i = 0; i < iterations; i++) { // TODO : stop criterion
-		int count = 0;
+template<typename T, typename Acc>
+double NetLearner<T, Acc>::learn(const std::vector<Sample<T>>& samples, int iterations, int miniBatch, double learningRate, int threads) {
+
+	return learnSamples(SampleRows<T>{ samples }, iterations, miniBatch, learningRate, threads);
+}
+
+template<typename T, typename Acc>
+double NetLearner<T, Acc>::learn(const Dataset<T>& dataset, int iterations, int miniBatch, double learningRate, int threads) {
+
+	return learnSamples(dataset, iterations, miniBatch, learningRate, threads);
+}
+
+template<typename T, typename Acc>
+template<typename Samples>
+double NetLearner<T, Acc>::learnSamples(const Samples& samples, int iterations, int miniBatch, double learningRate, int threads) {
+
+	if (miniBatch > 0) { return learnBatches(samples, iterations, miniBatch, learningRate, threads); }
+	return learnSequential<Acc>(net, samples, iterations, miniBatch, learningRate);
+}
+
+template<typename T, typename Acc>
+void NetLearner<T, Acc>::preparePool(int threads) {
+
+	// created once with all the hardware threads (only grown for more), the calls run fewer tasks on it when they need less
+	if (!pool || pool->size() < threads) { pool = std::make_shared<ThreadPool>(std::max(threads, ThreadPool::defaultThreads())); }
+}
+
+template<typename T, typename Acc>
+void NetLearner<T, Acc>::prepareThreads(int threads) {
+
+	preparePool(threads);
+	while (workspaces.size() < threads) { workspaces.push_back(net.createWorkspace(true)); }
+}
+
+template<typename T, typename Acc>
+template<typename Samples>
+double NetLearner<T, Acc>::learnBatches(const Samples& samples, int iterations, int miniBatch, double learningRate, int threads) {
+
+	int inputSize = samples.inputSize(), outputSize = samples.outputSize();
+	std::vector<T> inputs(miniBatch * inputSize), outputs(miniBatch * outputSize);
+
+	if (threads <= 0) { threads = ThreadPool::defaultThreads(); }
+	threads = std::min(threads, miniBatch);
+	if (threads > 1) { prepareThreads(threads); }
+
+	Acc error = 0;
+	for (int i = 0; i < iterations; i++) {
 		error = 0;
-		for (const Sample& s : samples) {
-
-			net.setInput(s.input.data());
-			net.activate();
-			auto output = net.getOuput();
-			for (int i = 0; i < output.size(); i++) {
-				double diff = output[i] - s.output[i];
-				error += abs(diff); // squared or abs ?
-			}
-			net.setDesiredOutput(s.output.data());
-			net.backtrack();
-			if (count >= miniBatch && miniBatch >= 0) { // minibatch
-				count = 0;
-				net.update(learningRate);
-			}
-			count++;
+		for (int first = 0; first < samples.size(); first += miniBatch) {
+
+			// each slice is packed into the matrices by its thread
+			int batchSize = std::min<int>(miniBatch, samples.size() - first);
+			learnBatch(inputs.data(), outputs.data(), batchSize, threads, [&](int begin, int end) {
+				for (int s = begin; s < end; s++) { // (rows that aren't stored as T are written in place)
+					T* inputRow = inputs.data() + s * inputSize;
+					T* outputRow = outputs.data() + s * outputSize;
+					const T* input = samples.input(first + s, inputRow);
+					const T* output = samples.output(first + s, outputRow);
+					if (input != inputRow) { std::copy(input, input + inputSize, inputRow); }
+					if (output != outputRow) { std::copy(output, output + outputSize, outputRow); }
+				}
+			}, error);
+			net.update(learningRate);
 		}
-		net.update(learningRate);
 	}
 	return error / samples.size();
 }
 
-std::vector<double> NetLearner::apply(const std::vector<double>& input) {
+template<typename T, typename Acc>
+template<typename Pack>
+void NetLearner<T, Acc>::learnBatch(const T* inputs, const T* outputs, int batchSize, int threads, const Pack& pack, Acc& error) {
+
+	int inputSize = net.inputSize(), outputSize = net.outputSize();
+	int nbSlices = std::min(threads, batchSize);
+	std::vector<Acc> errors(nbSlices); // error of each slice
+
+	// each slice is forwarded and backtracked in its own workspace
+	auto learnSlice = [&](int k) {
+		int begin = (k * batchSize) / nbSlices, end = ((k + 1) * batchSize) / nbSlices;
+		pack(begin, end);
+		const T* in = inputs + begin * inputSize;
+		const T* out = outputs + begin * outputSize;
+		if (nbSlices == 1) { // directly in the network
+			net.activateBatch(in, end - begin);
+			auto output = net.getOutputBatch();
+			errors[k] = 0;
+			for (int j = 0; j < output.size(); j++) { errors[k] += std::abs(Acc(output[j]) - out[j]); }
+			net.setDesiredOutputBatch(out);
+			net.backtrackBatch();
+			return;
+		}
+		Workspace& ws = workspaces[k];
+		net.activateBatch(ws, in, end - begin);
+		const T* output = ws.values(ws.layers.size() - 1);
+		int stride = ws.layers.back().stride;
+		errors[k] = 0;
+		for (int s = 0; s < end - begin; s++) {
+			for (int j = 0; j < outputSize; j++) { errors[k] += std::abs(Acc(output[s * stride + j]) - out[s * outputSize + j]); }
+		}
+		net.setDesiredOutputBatch(ws, out);
+		net.backtrackBatch(ws);
+	};
+
+	if (nbSlices == 1) { learnSlice(0); }
+	else {
+		pool->run(nbSlices, learnSlice);
+
+		// tree reduction of the gradients (always in the same order, for deterministic results)
+		for (int step = 1; step < nbSlices; step *= 2) {
+			pool->run((nbSlices + 2 * step - 1) / (2 * step), [&](int pair) {
+				int k = pair * 2 * step;
+				if (k + step < nbSlices) { workspaces[k].addGradients(workspaces[k + step]); }
+			});
+		}
+		net.addGradients(workspaces[0]);
+		pool->run(nbSlices, [&](int k) { workspaces[k].clearGradients(); });
+	}
+	for (int k = 0; k < nbSlices; k++) { error += errors[k]; }
+}
+
+template<typename T, typename Acc>
+double NetLearner<T, Acc>::learn(BatchLoader<T>& loader, int iterations, double learningRate, int threads) {
+
+	if (threads <= 0) { threads = ThreadPool::defaultThreads(); }
+	threads = std::min(threads, loader.getBatchSize());
+	if (threads > 1) { prepareThreads(threads); }
+
+	// the loader packs the next batches while this one is learnt
+	loader.start(iterations);
+	typename BatchLoader<T>::Batch batch;
+	Acc error = 0;
+	for (long long b = 0; loader.next(batch); b++) {
+		if (b % loader.batchesPerEpoch() == 0) { error = 0; }
+		learnBatch(batch.inputs, batch.outputs, batch.size, threads, [](int, int) {}, error);
+		net.update(learningRate);
+	}
+	return error / loader.getDataset().size();
+}
+
+template<typename T, typename Acc>
+double NetLearner<T, Acc>::learnAsync(const std::vector<Sample<T>>& samples, int iterations, double learningRate, int threads) {
 
-	net.setInput(input.data());
-	net.activate();
-	return net.getOuput();
+	return learnSamplesAsync(SampleRows<T>{ samples }, iterations, learningRate, threads);
 }
 
-/*void NearestNeighbor::learn(const std::vector<Sample>& samples) {
+template<typename T, typename Acc>
+double NetLearner<T, Acc>::learnAsync(const Dataset<T>& dataset, int iterations, double learningRate, int threads) {
 
-	this->samples.insert(this->samples.end(),samples.begin(), samples.end());
+	return learnSamplesAsync(dataset, iterations, learningRate, threads);
 }
 
-std::vector<double> NearestNeighbor::apply(const std::vector<double>& input) {
+template<typename T, typename Acc>
+template<typename Samples>
+double NetLearner<T, Acc>::learnSamplesAsync(const Samples& samples, int iterations, double learningRate, int threads) {
+
+	// the updates go straight to the coefficients : the workspaces don't need gradients
+	if (threads <= 0) { threads = ThreadPool::defaultThreads(); }
+	preparePool(threads);
+	while (inferenceWorkspaces.size() < threads) { inferenceWorkspaces.push_back(net.createWorkspace()); }
+
+	std::atomic<long long> updates(0); // nb of samples applied by all threads
+	std::vector<Acc> errors(threads);
+	std::vector<long long> staleness(threads);
+	auto start = std::chrono::steady_clock::now();
+
+	pool->run(threads, [&](int k) {
+		Workspace& ws = inferenceWorkspaces[k];
+		std::vector<T> inputBuffer(samples.inputSize()), outputBuffer(samples.outputSize());
+		Acc error = 0;
+		long long stale = 0;
+		for (int i = 0; i < iterations; i++) {
+			error = 0;
+			for (int s = k; s < samples.size(); s += threads) { // samples k, k + threads, ...
+				const T* input = samples.input(s, inputBuffer.data());
+				const T* desired = samples.output(s, outputBuffer.data());
+				long long before = updates.load(std::memory_order_relaxed);
 
-	double bestDist = INFINITY;
-	const Sample* bestSample = NULL;
+				net.activateBatch(ws, input, 1);
+				const T* output = ws.values(ws.layers.size() - 1);
+				for (int j = 0; j < outputBuffer.size(); j++) { error += std::abs(Acc(output[j]) - desired[j]); }
+				net.setDesiredOutputBatch(ws, desired);
+				net.backtrackAndUpdate(ws, learningRate);
 
-	for (const Sample& s : samples) {
-		double dist = 0;
-		for (int i = 0; i < input.size(); i++) {
-			double diff = input[i] - s.input[i];
-			dist += diff*diff;
+				stale += updates.fetch_add(1, std::memory_order_relaxed) - before;
+			}
 		}
-		if (dist < bestDist) {
-			bestDist = dist;
-			bestSample = &s;
+		errors[k] = error;
+		staleness[k] = stale;
+	});
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	Acc error = 0;
+	long long stale = 0;
+	for (int k = 0; k < threads; k++) { error += errors[k]; stale += staleness[k]; }
+	asyncStats.updates = updates;
+	asyncStats.meanStaleness = updates > 0 ? double(stale) / updates : 0;
+	asyncStats.samplesPerSecond = seconds > 0 ? updates / seconds : 0;
+	return error / samples.size();
+}
+
+// chunks of applyBatch : enough work to amortize the scheduling, few enough samples for the layers to stay in cache,
+// and several chunks per thread when possible, so that threads which finish early can take more
+static const double minChunkWork = 1 << 16; // in multiply-adds
+static const int maxChunkSize = 256; // in samples
+static const int chunksPerThread = 4;
+
+template<typename T, typename Acc>
+void NetLearner<T, Acc>::applyBatch(const T* inputs, T* outputs, int nbSamples, int threads) {
+
+	if (nbSamples <= 0) { return; }
+	if (threads <= 0) { threads = ThreadPool::defaultThreads(); }
+
+	double sampleWork = 0; // multiply-adds per sample
+	for (const auto& s : net.synapses) { sampleWork += double(s.inputLayer) * s.outputLayer; }
+	int chunkSize = std::max<int>(1, int(minChunkWork / std::max(sampleWork, 1.0)));
+	chunkSize = std::max(chunkSize, (nbSamples + threads * chunksPerThread - 1) / (threads * chunksPerThread));
+	chunkSize = std::min(chunkSize, maxChunkSize);
+	int nbChunks = (nbSamples + chunkSize - 1) / chunkSize;
+	threads = std::min(threads, nbChunks);
+
+	if (threads > 1) { preparePool(threads); }
+	while (inferenceWorkspaces.size() < threads) { inferenceWorkspaces.push_back(net.createWorkspace()); }
+
+	int inputSize = net.inputSize(), outputSize = net.outputSize();
+	std::atomic<int> nextChunk(0);
+	auto applyChunks = [&](int k) { // each thread takes chunks until there are none left
+		for (int c = nextChunk++; c < nbChunks; c = nextChunk++) {
+			int first = c * chunkSize, size = std::min(chunkSize, nbSamples - first);
+			net.applyBatch(inputs + size_t(first) * inputSize, outputs + size_t(first) * outputSize, size, inferenceWorkspaces[k]);
 		}
-	}
-	return bestSample->output;
+	};
+	if (threads == 1) { applyChunks(0); }
+	else { pool->run(threads, applyChunks); }
 }
 
-#include <queue>
+template<typename T, typename Acc>
+std::vector<T> NetLearner<T, Acc>::apply(const std::vector<T>& input) const {
+
+	std::vector<T> output(net.outputSize());
+	net.apply(input.data(), output.data());
+	return output;
+}
 
-void KNearestNeighbors::learn(const std::vector<Sample>& samples) {
+template class NetLearner<double>;
+template class NetLearner<float>;
+template class NetLearner<float, double>;
+
+// index of the inputs of the samples
+static void buildIndex(const std::vector<Sample<>>& samples, NeighborIndex<double>& index) {
+
+	int dimension = samples.empty() ? 0 : samples[0].input.size();
+	std::vector<double> inputs;
+	inputs.reserve(samples.size() * dimension);
+	for (const Sample<>& s : samples) { inputs.insert(inputs.end(), s.input.begin(), s.input.end()); }
+	index.build(inputs.data(), samples.size(), dimension);
+}
+
+void NearestNeighbor::learn(const std::vector<Sample<>>& samples) {
 
 	this->samples.insert(this->samples.end(), samples.begin(), samples.end());
+	buildIndex(this->samples, index);
 }
 
-std::vector<double> KNearestNeighbors::apply(const std::vector<double>& input) {
+std::vector<double> NearestNeighbor::apply(const std::vector<double>& input) const {
 
-	struct Result {
-		double dist; const Sample* s;
-	};
-	struct ResultComparator {
-		bool operator()(const Result& a, const Result& b) { return a.dist < b.dist; };
-	};
+	std::vector<NeighborIndex<double>::Neighbor> nearest;
+	index.search(input.data(), 1, nearest);
+	if (nearest.empty()) { return std::vector<double>(); }
+	return samples[nearest[0].index].output;
+}
+
+void KNearestNeighbors::learn(const std::vector<Sample<>>& samples) {
+
+	this->samples.insert(this->samples.end(), samples.begin(), samples.end());
+	buildIndex(this->samples, index);
+}
+
+std::vector<double> KNearestNeighbors::apply(const std::vector<double>& input) const {
+
+	std::vector<NeighborIndex<double>::Neighbor> nearest;
+	index.search(input.data(), nbNeighbors, nearest);
+	if (nearest.empty()) { return std::vector<double>(); }
 
-	std::priority_queue<Result,std::vector<Result>, ResultComparator> bestSamples;
-	for (const Sample& s : samples) {
-		double dist = 0;
-		for (int i = 0; i < input.size(); i++) {
-			double diff = input[i] - s.input[i];
-			dist += diff*diff;
-		}
-		if (bestSamples.size() < this->nbNeighbors) {
-			bestSamples.push({ dist, &s });
-		}
-		else if (dist < bestSamples.top().dist) {
-			bestSamples.pop();
-			bestSamples.push({ dist, &s });
-		}
-	}
-	
 	// return the average of the best samples
-	int nbFound = bestSamples.size();
-	std::vector<double> dst(bestSamples.top().s->output.size());
-	while (bestSamples.size() > 0) {
-		Result r = bestSamples.top();
-		for (int i = 0; i < dst.size(); i++) {
-			dst[i] += r.s->output[i];
-		}
-		bestSamples.pop();
+	std::vector<double> dst(samples[nearest[0].index].output.size());
+	for (const NeighborIndex<double>::Neighbor& n : nearest) {
+		const std::vector<double>& output = samples[n.index].output;
+		for (int i = 0; i < dst.size(); i++) { dst[i] += output[i]; }
 	}
-	for (double& d : dst) { d /= nbFound; }
+	for (double& d : dst) { d /= nearest.size(); }
 	return dst;
-}*/
\ No newline at end of file
+}
\ No newline at end of file
@@ -3,49 +3,194 @@
 #include <vector>
 
 // learning sample
+template<typename T = double>
 struct Sample {
-	std::vector<double> input;
-	std::vector<double> output;
+	std::vector<T> input;
+	std::vector<T> output;
 };
 
-// TODO : learn on Sample iterator, instead of vector
+#include "Dataset.h"
+
+// vector of samples, seen through the interface of a Dataset (without copies)
+template<typename T>
+struct SampleRows {
+	typedef T Scalar;
+	const std::vector<Sample<T>>& samples;
+	int size() const { return samples.size(); }
+	int inputSize() const { return samples[0].input.size(); }
+	int outputSize() const { return samples[0].output.size(); }
+	const T* input(int i, T*) const { return samples[i].input.data(); }
+	const T* output(int i, T*) const { return samples[i].output.data(); }
+};
+
+template<typename T = double>
 class Learner {
 public:
-	virtual void learn(const std::vector<Sample>& samples) = 0;
-	virtual std::vector<double> apply(const std::vector<double>& input) = 0;
+	virtual void learn(const std::vector<Sample<T>>& samples) = 0;
+	virtual void learn(const Dataset<T>& dataset) { learn(dataset.toSamples()); }
+	virtual std::vector<T> apply(const std::vector<T>& input) const = 0;
 };
 
+#include "BatchLoader.h"
+#include "NeighborIndex.h"
 #include "NeuralNetwork.h"
+#include "StaticNetwork.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <memory>
+
+// learns the samples one by one, with the single-sample interface of a network (Network or StaticNetwork)
+// samples is a Dataset or SampleRows ; miniBatch : nb of samples between two updates (-1 : one update per iteration)
+// returns the error during the last iteration
+template<typename Acc, typename Net, typename Samples>
+double learnSequential(Net& net, const Samples& samples, int iterations, int miniBatch, double learningRate) {
+
+	typedef typename Samples::Scalar T;
+	std::vector<T> inputBuffer(samples.inputSize()), outputBuffer(samples.outputSize());
+	Acc error = 0;
+	for (int i = 0; i < iterations; i++) { // TODO : stop criterion
+		int count = 0;
+		error = 0;
+		for (int s = 0; s < samples.size(); s++) {
+
+			const T* input = samples.input(s, inputBuffer.data());
+			const T* desired = samples.output(s, outputBuffer.data());
+			net.setInput(input);
+			net.activate();
+			auto output = net.getOuput();
+			for (int i = 0; i < output.size(); i++) {
+				Acc diff = output[i] - desired[i];
+				error += std::abs(diff); // squared or abs ?
+			}
+			net.setDesiredOutput(desired);
+			net.backtrack();
+			if (count >= miniBatch && miniBatch >= 0) { // minibatch
+				count = 0;
+				net.update(learningRate);
+			}
+			count++;
+		}
+		net.update(learningRate);
+	}
+	return error / samples.size();
+}
 
-class NetLearner : Learner {
+// T is the scalar type of the samples and of the network, Acc the type of its accumulations
+template<typename T = double, typename Acc = T>
+class NetLearner : Learner<T> {
+
+	typedef typename Network<T, Acc>::Workspace Workspace;
+
+	// samples is a Dataset or SampleRows
+	template<typename Samples>
+	double learnSamples(const Samples& samples, int iterations, int miniBatch, double learningRate, int threads);
+	template<typename Samples> // learns on miniBatch samples at once, with matrix products
+	double learnBatches(const Samples& samples, int iterations, int miniBatch, double learningRate, int threads);
+	// forwards and backtracks a batch in slices, once pack(begin, end) filled their rows, and adds the gradients to the network
+	// (and the errors of the slices to error)
+	template<typename Pack>
+	void learnBatch(const T* inputs, const T* outputs, int batchSize, int threads, const Pack& pack, Acc& error);
+	template<typename Samples>
+	double learnSamplesAsync(const Samples& samples, int iterations, double learningRate, int threads);
+
+	// data-parallel training : each thread has a slice of the batch, and its own copy of the gradient
+	std::shared_ptr<ThreadPool> pool;
+	std::vector<Workspace> workspaces; // one per thread
+	void preparePool(int threads); // (at least threads)
+	void prepareThreads(int threads); // the pool and the workspaces with gradients
+	std::vector<Workspace> inferenceWorkspaces; // one per thread, without gradients (inference and asynchronous training)
 
 public:
-	Network net; // TODO : private
-	NetLearner(Network net) : net(net) {};
+	Network<T, Acc> net; // TODO : private
+	NetLearner(Network<T, Acc> net) : net(std::move(net)), asyncStats() {}; // (moved, so that an imported network keeps its mapped weights)
 	double learn( // returns the error of the model on all samples
-		const std::vector<Sample>& samples,
+		const std::vector<Sample<T>>& samples,
 		int iterations,
 		int miniBatch = -1, // set to -1 to disable minibatches
-		double learningRate = 0.01
+		double learningRate = 0.01,
+		int threads = 0 // threads used for minibatches (0 : all hardware threads), results only depend on this number
 	);
-	void learn(const std::vector<Sample>& samples) { learn(samples, 1); }; // HACK ?
-	std::vector<double> apply(const std::vector<double>& input); // TODO : make it const
+	double learn(const Dataset<T>& dataset, int iterations, int miniBatch = -1, double learningRate = 0.01, int threads = 0);
+	// learns the batches of a loader (prepared in the background, while the previous one is learnt) ;
+	// returns the error of the model on all samples, during the last iteration
+	double learn(BatchLoader<T>& loader, int iterations, double learningRate = 0.01, int threads = 0);
+
+	// asynchronous (Hogwild) training : each thread learns on its share of the samples and updates
+	// the coefficients right away, without locks nor barriers ; best for sparse inputs
+	double learnAsync( // returns the error of the model on all samples, during the last iteration
+		const std::vector<Sample<T>>& samples,
+		int iterations,
+		double learningRate = 0.01,
+		int threads = 0 // 0 : all hardware threads
+	);
+	double learnAsync(const Dataset<T>& dataset, int iterations, double learningRate = 0.01, int threads = 0);
+	struct AsyncStats
+	{
+		long long updates; // nb of samples applied to the coefficients
+		double meanStaleness; // average nb of updates made by other threads while a sample was being processed
+		double samplesPerSecond;
+	} asyncStats; // of the last call to learnAsync
+
+	void learn(const std::vector<Sample<T>>& samples) { learn(samples, 1); }; // HACK ?
+	void learn(const Dataset<T>& dataset) { learn(dataset, 1); };
+	std::vector<T> apply(const std::vector<T>& input) const;
+	void apply(const T* input, T* output) const { net.apply(input, output); } // without allocations, thread-safe
+
+	// inference of nbSamples samples (inputs and outputs are row-major nbSamples x inputSize / outputSize matrices)
+	// the samples are split in chunks among the threads of the pool, and each chunk goes through the layers at once ;
+	// chunks are sized from the cost of a sample, so that small batches stay on the calling thread
+	void applyBatch(const T* inputs, T* outputs, int nbSamples, int threads = 0); // threads : 0 for all hardware threads
+};
+
+// learner of a network whose topology is fixed at compile time (eg: NetLearner<StaticNetwork<double, 2, 3, 1>>)
+// the samples are learned one by one, minibatches only change the frequency of the updates
+template<typename T, int... sizes, typename Acc>
+class NetLearner<StaticNetwork<T, sizes...>, Acc> : Learner<T> {
+
+public:
+	StaticNetwork<T, sizes...> net;
+	NetLearner(const StaticNetwork<T, sizes...>& net) : net(net) {};
+	double learn( // returns the error of the model on all samples
+		const std::vector<Sample<T>>& samples,
+		int iterations,
+		int miniBatch = -1, // nb of samples between two updates, -1 for a single update per iteration
+		double learningRate = 0.01
+	) { return learnSequential<T>(net, SampleRows<T>{ samples }, iterations, miniBatch, learningRate); }
+	double learn(const Dataset<T>& dataset, int iterations, int miniBatch = -1, double learningRate = 0.01) {
+		return learnSequential<T>(net, dataset, iterations, miniBatch, learningRate);
+	}
+
+	void learn(const std::vector<Sample<T>>& samples) { learn(samples, 1); };
+	void learn(const Dataset<T>& dataset) { learn(dataset, 1); };
+	std::vector<T> apply(const std::vector<T>& input) const {
+
+		std::vector<T> output(net.outputSize());
+		net.apply(input.data(), output.data());
+		return output;
+	}
+	void apply(const T* input, T* output) const { net.apply(input, output); }
 };
 
-class NearestNeighbor : Learner {
+// output of the nearest sample ; learn adds the samples and rebuilds the index of their inputs
+// (a KD-tree in low dimensions, a vantage-point tree otherwise), which apply searches by branch and bound
+class NearestNeighbor : Learner<> {
 
-	std::vector<Sample> samples;
+	std::vector<Sample<>> samples;
+	NeighborIndex<double> index;
 public:
-	void learn(const std::vector<Sample>& samples);
-	std::vector<double> apply(const std::vector<double>& input);
+	void learn(const std::vector<Sample<>>& samples);
+	std::vector<double> apply(const std::vector<double>& input) const;
 };
 
-class KNearestNeighbors : Learner {
+// average output of the nbNeighbors nearest samples (indexed as for NearestNeighbor)
+class KNearestNeighbors : Learner<> {
 
-	std::vector<Sample> samples;
+	std::vector<Sample<>> samples;
+	NeighborIndex<double> index;
 	int nbNeighbors;
 public:
 	KNearestNeighbors(int nbNeighbors = 10) : nbNeighbors(nbNeighbors) {};
-	void learn(const std::vector<Sample>& samples);
-	std::vector<double> apply(const std::vector<double>& input);
+	void learn(const std::vector<Sample<>>& samples);
+	std::vector<double> apply(const std::vector<double>& input) const;
 };
\ No newline at end of file
@@ -1,10 +1,18 @@
 #pragma once
 
+#include "Idx.h"
+#include "ImageCache.h"
 #include "Learning.h"
+#include "Pyramid.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <ctime>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <stdexcept>
 #include <opencv2\opencv.hpp>
 
 // learns the XOR with different parameters, and outputs a CSV
@@ -29,7 +37,7 @@ void testXOR(std::string outputCsvPath) {
 		}
 	}
 
-	std::vector<Sample> samples = {
+	std::vector<Sample<>> samples = {
 		{ { 0,0 },{ 0 } },
 		{ { 0,1 },{ 1 } },
 		{ { 1,0 },{ 1 } },
@@ -45,7 +53,7 @@ void testXOR(std::string outputCsvPath) {
 
 		results << param.initCoeffs << ','
 			<< param.miniBatch << ',' << param.learningRate << ',';
-		NetLearner learner(Network({ 2, 3, 1 }, param.initCoeffs));
+		NetLearner<> learner(Network<>({ 2, 3, 1 }, param.initCoeffs));
 		results << learner.learn(samples, 10, param.miniBatch, param.learningRate)
 			<< ',' << learner.learn(samples, 90, param.miniBatch, param.learningRate)
 			<< ',' << learner.learn(samples, 900, param.miniBatch, param.learningRate)
@@ -59,7 +67,7 @@ void testXOR(std::string outputCsvPath) {
 	clock_t start = clock();
 	std::cout << "testing " << nbStarts << " random starts :" << std::endl;
 	for (int i = 0; i < nbStarts; i++) {
-		NetLearner learner(Network({ 2, 10, 1 }, 1));
+		NetLearner<> learner(Network<>({ 2, 10, 1 }, 1));
 		errors.push_back(learner.learn(samples, 1000, -1, 10));
 
 		/*cv::Mat im(cv::Size(512, 512), CV_8UC1);
@@ -93,7 +101,7 @@ void testXOR(std::string outputCsvPath) {
 void test1DFunction(double(*func)(double)) {
 
 	// generating samples
-	std::vector<Sample> samples(512);
+	std::vector<Sample<>> samples(512);
 	for (int i = 0; i < samples.size(); i++) {
 		double x = double(rand()) / RAND_MAX;
 		double y = func(x);
@@ -101,7 +109,7 @@ void test1DFunction(double(*func)(double)) {
 	}
 
 	// learning from samples
-	NetLearner learner(Network({ 1,10,10,1 }));
+	NetLearner<> learner(Network<>({ 1,10,10,1 }));
 	for (int i = 0; true; i++) {
 		learner.learn(samples, 100, 5);
 
@@ -129,10 +137,433 @@ void test1DFunction(double(*func)(double)) {
 	}
 }
 
+// prints the result of a check
+bool check(const std::string& name, bool passed) {
+
+	std::cout << (passed ? "ok     " : "FAILED ") << name << std::endl;
+	return passed;
+}
+
+// the kernels of each instruction set of the host against the scalar ones
+bool testKernels() {
+
+	int n = 1003; // (not a multiple of the registers : the tails too)
+	std::vector<double> a(n), b(n), y(n), yRef(n), v(n), vRef(n);
+	std::vector<float> af(n), bf(n), yf(n), yfRef(n), vf(n), vfRef(n);
+	double magnitude = 0; // of the dot products, for their rounding errors
+	for (int i = 0; i < n; i++) {
+		a[i] = 40 * sin(i); b[i] = cos(0.7 * i);
+		af[i] = float(a[i]); bf[i] = float(b[i]);
+		magnitude += std::abs(a[i] * b[i]);
+	}
+
+	Kernels::Isa host = Kernels::isa();
+	Kernels::setIsa(Kernels::Scalar);
+	double dotRef = Kernels::dot<double>(a.data(), b.data(), n), dotMixedRef = Kernels::dot<double>(af.data(), bf.data(), n);
+	float dotFloatRef = Kernels::dot<float>(af.data(), bf.data(), n);
+	yRef = b; Kernels::axpy(0.3, a.data(), yRef.data(), n);
+	yfRef = bf; Kernels::axpy(0.3f, af.data(), yfRef.data(), n);
+	Kernels::sigmoid(a.data(), vRef.data(), n);
+	Kernels::sigmoid(af.data(), vfRef.data(), n);
+
+	bool passed = true;
+	for (int isa = Kernels::SSE2; isa <= Kernels::detectIsa(); isa++) {
+		Kernels::setIsa(Kernels::Isa(isa));
+		bool same = std::abs(Kernels::dot<double>(a.data(), b.data(), n) - dotRef) <= 1e-14 * magnitude
+			&& std::abs(Kernels::dot<double>(af.data(), bf.data(), n) - dotMixedRef) <= 1e-14 * magnitude
+			&& std::abs(Kernels::dot<float>(af.data(), bf.data(), n) - dotFloatRef) <= 1e-5 * magnitude;
+		y = b; Kernels::axpy(0.3, a.data(), y.data(), n);
+		yf = bf; Kernels::axpy(0.3f, af.data(), yf.data(), n);
+		Kernels::sigmoid(a.data(), v.data(), n);
+		Kernels::sigmoid(af.data(), vf.data(), n);
+		for (int i = 0; i < n; i++) {
+			same &= std::abs(y[i] - yRef[i]) <= 1e-14 && std::abs(yf[i] - yfRef[i]) <= 1e-5
+				&& std::abs(v[i] - vRef[i]) <= 1e-15 && std::abs(vf[i] - vfRef[i]) <= 1e-6;
+		}
+		passed &= check(std::string("the ") + Kernels::isaName(Kernels::Isa(isa)) + " kernels match the scalar ones", same);
+	}
+	Kernels::setIsa(host);
+	return passed;
+}
+
+// the batched passes of Network (matrix products) against the passes of the samples one by one : same outputs, same gradients
+bool testBatchedNetwork() {
+
+	srand(1);
+	Network<> perSample({ 50, 37, 4, 3 }, 0.5);
+	Network<> batched = perSample;
+	int n = 13;
+	std::vector<double> inputs(n * 50), desired(n * 3), outputs(n * 3), output(3);
+	for (double& x : inputs) { x = double(rand()) / RAND_MAX; }
+	for (double& y : desired) { y = double(rand()) / RAND_MAX; }
+
+	for (int s = 0; s < n; s++) {
+		perSample.setInput(&inputs[s * 50]);
+		perSample.activate();
+		perSample.setDesiredOutput(&desired[s * 3]);
+		perSample.backtrack();
+	}
+	batched.activateBatch(inputs.data(), n);
+	batched.setDesiredOutputBatch(desired.data());
+	batched.backtrackBatch();
+	double maxDiff = 0;
+	for (int l = 0; l < perSample.synapses.size(); l++) {
+		for (int i = 0; i < perSample.synapses[l].gradient.size(); i++) {
+			maxDiff = std::max(maxDiff, std::abs(perSample.synapses[l].gradient[i] - batched.synapses[l].gradient[i]));
+		}
+		for (int i = 0; i < perSample.synapses[l].biasGradient.size(); i++) {
+			maxDiff = std::max(maxDiff, std::abs(perSample.synapses[l].biasGradient[i] - batched.synapses[l].biasGradient[i]));
+		}
+	}
+	bool passed = check("batched gradients match the per-sample ones", maxDiff < 1e-12);
+
+	Network<>::Workspace ws = perSample.createWorkspace();
+	perSample.applyBatch(inputs.data(), outputs.data(), n, ws);
+	maxDiff = 0;
+	for (int s = 0; s < n; s++) {
+		perSample.apply(&inputs[s * 50], output.data());
+		for (int o = 0; o < 3; o++) { maxDiff = std::max(maxDiff, std::abs(output[o] - outputs[s * 3 + o])); }
+	}
+	return check("batched inference matches the per-sample one", maxDiff < 1e-12) && passed;
+}
+
+// largest difference between the coefficients (and bias) of two networks of the same topology
+template<typename T, typename Acc>
+double maxDifference(const Network<T, Acc>& a, const Network<T, Acc>& b) {
+
+	double maxDiff = 0;
+	for (int l = 0; l < a.synapses.size(); l++) {
+		for (size_t i = 0; i < a.synapses[l].coefficients.size(); i++) {
+			maxDiff = std::max(maxDiff, std::abs(double(a.synapses[l].coefficients[i]) - double(b.synapses[l].coefficients[i])));
+		}
+		for (size_t i = 0; i < a.synapses[l].bias.size(); i++) {
+			maxDiff = std::max(maxDiff, std::abs(double(a.synapses[l].bias[i]) - double(b.synapses[l].bias[i])));
+		}
+	}
+	return maxDiff;
+}
+
+// data-parallel training : the gradients of the threads are summed in a fixed order, so two trainings with as many threads
+// learn the same coefficients, bit for bit (and the same as a single thread, up to rounding)
+bool testParallelTraining() {
+
+	srand(2);
+	std::vector<Sample<>> samples(200);
+	for (Sample<>& s : samples) {
+		for (int i = 0; i < 8; i++) { s.input.push_back(double(rand()) / RAND_MAX); }
+		for (int o = 0; o < 2; o++) { s.output.push_back(double(rand()) / RAND_MAX); }
+	}
+	Network<> initial({ 8, 16, 2 }, 0.5);
+	NetLearner<> first(initial), second(initial), single(initial);
+	first.learn(samples, 5, 32, 0.1, 3);
+	second.learn(samples, 5, 32, 0.1, 3);
+	single.learn(samples, 5, 32, 0.1, 1);
+	bool passed = check("training on 3 threads is deterministic", maxDifference(first.net, second.net) == 0);
+	return check("training on 3 threads matches a single thread", maxDifference(first.net, single.net) < 1e-12) && passed;
+}
+
+// model files : a network exported then imported has the same coefficients, activations and outputs (converted to floats,
+// up to their rounding), and a truncated file is rejected
+bool testModelFile() {
+
+	std::string fileName = "testModel.nnet";
+	srand(3);
+	Network<> net({ 20, 9, 3 }, 0.5, { ReLU, Sigmoid });
+	net.exportToFile(fileName);
+	Network<> imported = Network<>::importFromFile(fileName);
+	Network<float> converted = Network<float>::importFromFile(fileName);
+
+	std::vector<double> input(20), output(3), importedOutput(3);
+	std::vector<float> inputFloat(20), convertedOutput(3);
+	for (int i = 0; i < 20; i++) { input[i] = double(rand()) / RAND_MAX; inputFloat[i] = float(input[i]); }
+	net.apply(input.data(), output.data());
+	imported.apply(input.data(), importedOutput.data());
+	converted.apply(inputFloat.data(), convertedOutput.data());
+	bool same = maxDifference(net, imported) == 0 && output == importedOutput;
+	for (int o = 0; o < 3; o++) { same &= std::abs(output[o] - convertedOutput[o]) < 1e-5; }
+	bool passed = check("a model file gives back its network", same);
+
+	// the same file, cut in the middle of its weights
+	std::vector<char> bytes;
+	{
+		std::ifstream file(fileName, std::ios::binary);
+		bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	{
+		std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+		file.write(bytes.data(), bytes.size() / 2);
+	}
+	bool rejected = false;
+	try { Network<>::importFromFile(fileName); }
+	catch (const std::runtime_error&) { rejected = true; }
+	std::remove(fileName.c_str());
+	return check("a truncated model file is rejected", rejected) && passed;
+}
+
+// IDX files : a valid one is read in place, and the invalid ones (other type of values or nb of dimensions, invalid
+// dimension, truncated values) are rejected
+bool testIdxFile() {
+
+	std::string fileName = "testIdx.idx";
+	auto tryFile = [&](const std::vector<unsigned char>& bytes, int nbDimensions) {
+		{
+			std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+			file.write((const char*)bytes.data(), bytes.size());
+		}
+		try { IdxFile idx(fileName, nbDimensions); }
+		catch (const std::runtime_error&) { return false; }
+		return true;
+	};
+
+	// 3 items of 2 x 2 bytes
+	std::vector<unsigned char> valid = { 0, 0, 0x08, 3, 0, 0, 0, 3, 0, 0, 0, 2, 0, 0, 0, 2 };
+	for (int i = 0; i < 12; i++) { valid.push_back(i); }
+	bool read = tryFile(valid, 3);
+	if (read) {
+		IdxFile idx(fileName, 3);
+		read = idx.count() == 3 && idx.itemSize() == 4 && idx.offset() == 16 && std::equal(valid.begin() + 16, valid.end(), idx.data());
+	}
+	bool passed = check("an IDX file is read", read);
+
+	std::vector<unsigned char> floats = valid, zero = valid, truncated = valid;
+	floats[2] = 0x0D;
+	zero[11] = 0;
+	truncated.pop_back();
+	bool rejected = !tryFile(floats, 3) && !tryFile(valid, 2) && !tryFile(zero, 3) && !tryFile(truncated, 3);
+	std::remove(fileName.c_str());
+	return check("invalid IDX files are rejected", rejected) && passed;
+}
+
+// image caches : a cache gives back its samples, and a corrupted one is rejected (unless it isn't verified)
+bool testImageCache() {
+
+	std::string fileName = "testCache.cache";
+	int w = 5, h = 3, count = 4;
+	std::vector<unsigned char> pixels(size_t(count) * w * h);
+	for (int i = 0; i < pixels.size(); i++) { pixels[i] = (unsigned char)(i * 7); }
+	{
+		ImageCacheWriter writer(fileName, w, h, 1, ImageCache::ClassLabels);
+		for (int i = 0; i < count; i++) { writer.add(pixels.data() + i*w*h, 3 * i, "sample" + std::to_string(i)); }
+		writer.finish();
+	}
+	bool same = true;
+	{
+		ImageCache cache(fileName);
+		same = cache.size() == count && cache.width() == w && cache.height() == h && cache.channels() == 1;
+		for (int i = 0; i < count && same; i++) {
+			same = std::equal(pixels.data() + i*w*h, pixels.data() + (i + 1)*w*h, cache.pixels(i)) && cache.label(i) == 3 * i
+				&& cache.key(i) == "sample" + std::to_string(i);
+		}
+	}
+	bool passed = check("an image cache gives back its samples", same);
+
+	// the same file, with a pixel changed
+	{
+		std::fstream file(fileName, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(64 + 2 * w*h + 1);
+		file.put(char(pixels[2 * w*h + 1] ^ 1));
+	}
+	bool rejected = false, unverified = false;
+	try { ImageCache cache(fileName); }
+	catch (const std::runtime_error&) { rejected = true; }
+	try { ImageCache cache(fileName, false); unverified = cache.pixels(2)[1] == (pixels[2 * w*h + 1] ^ 1); }
+	catch (const std::runtime_error&) {}
+	std::remove(fileName.c_str());
+	return check("a corrupted image cache is rejected", rejected && unverified) && passed;
+}
+
+// non-maximum suppression against the greedy one on all the pairs : windows of several sizes, with distinct confidences
+bool testNonMaximumSuppression() {
+
+	srand(5);
+	std::vector<Detection> candidates(400);
+	for (int i = 0; i < candidates.size(); i++) {
+		int size = 8 + rand() % 40;
+		candidates[i] = { rand() % 300, rand() % 200, size, size + rand() % 8, 0, double(i) };
+	}
+	std::shuffle(candidates.begin(), candidates.end(), std::mt19937(5));
+	auto overlap = [](const Detection& a, const Detection& b) {
+		double w = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+		double h = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+		if (w <= 0 || h <= 0) { return 0.0; }
+		return w*h / (double(a.width) * a.height + double(b.width) * b.height - w*h);
+	};
+	std::vector<Detection> sorted = candidates;
+	std::sort(sorted.begin(), sorted.end(), [](const Detection& a, const Detection& b) { return a.confidence > b.confidence; });
+
+	bool passed = true;
+	for (double maxOverlap : { 0.0, 0.2, 0.5 }) {
+		for (int maxDetections : { 10, 1000 }) {
+			std::vector<Detection> expected;
+			for (const Detection& d : sorted) {
+				if (expected.size() == maxDetections) { break; }
+				bool suppressed = false;
+				for (const Detection& k : expected) { suppressed |= overlap(k, d) > maxOverlap; }
+				if (!suppressed) { expected.push_back(d); }
+			}
+			std::vector<Detection> kept = nonMaximumSuppression(candidates, maxDetections, maxOverlap);
+			passed &= kept.size() == expected.size();
+			for (int i = 0; i < kept.size() && passed; i++) {
+				passed &= kept[i].x == expected[i].x && kept[i].y == expected[i].y && kept[i].width == expected[i].width
+					&& kept[i].height == expected[i].height && kept[i].confidence == expected[i].confidence;
+			}
+		}
+	}
+	return check("non-maximum suppression keeps the windows of the greedy one", passed);
+}
+
+// nearest neighbors of the KD-tree and of the vantage-point tree against a brute-force search, in low and high dimension
+// (with duplicate points : the distances must be the same, the indices those of points at these distances)
+template<typename T>
+bool testNeighborIndex(int count, int dim) {
+
+	std::vector<T> points(size_t(count) * dim), queries(size_t(50) * dim);
+	for (T& v : points) { v = T(rand()) / RAND_MAX; }
+	for (T& v : queries) { v = T(rand()) / RAND_MAX; }
+	std::copy(points.begin(), points.begin() + 10 * dim, points.end() - 10 * dim);
+	std::copy(points.begin(), points.begin() + 5 * dim, queries.begin());
+	auto distance2 = [&](const T* a, const T* b) {
+		double dist = 0;
+		for (int i = 0; i < dim; i++) { double diff = double(a[i]) - double(b[i]); dist += diff*diff; }
+		return dist;
+	};
+
+	bool passed = true;
+	for (auto type : { NeighborIndex<T>::KdTree, NeighborIndex<T>::VantagePointTree, NeighborIndex<T>::Auto }) {
+		NeighborIndex<T> index;
+		index.build(points.data(), count, dim, type);
+		std::vector<typename NeighborIndex<T>::Neighbor> neighbors;
+		for (int q = 0; q < 50; q++) {
+			const T* query = queries.data() + size_t(q) * dim;
+			std::vector<double> expected(count);
+			for (int i = 0; i < count; i++) { expected[i] = distance2(query, points.data() + size_t(i) * dim); }
+			std::sort(expected.begin(), expected.end());
+			for (int k : { 1, 7, count + 3 }) {
+				index.search(query, k, neighbors);
+				passed &= neighbors.size() == std::min(k, count);
+				for (int i = 0; i < neighbors.size() && passed; i++) {
+					passed &= neighbors[i].distance == expected[i]
+						&& neighbors[i].distance == distance2(query, points.data() + size_t(neighbors[i].index) * dim);
+				}
+			}
+		}
+	}
+	return passed;
+}
+
+bool testNeighborIndex() {
+
+	srand(6);
+	bool lowDimension = testNeighborIndex<double>(500, 3) && testNeighborIndex<float>(500, 3);
+	bool highDimension = testNeighborIndex<double>(300, 40) && testNeighborIndex<float>(300, 40);
+	bool passed = check("KD and vantage-point trees find the nearest neighbors in dimension 3", lowDimension);
+	return check("KD and vantage-point trees find the nearest neighbors in dimension 40", highDimension) && passed;
+}
+
+// the StaticNetwork variants of the XOR and 1D function tests : from the same random draws, they must learn
+// the same coefficients as Network (up to rounding), only faster
+bool testStaticNetwork() {
+
+	std::vector<Sample<>> xorSamples = {
+		{ { 0,0 },{ 0 } },
+		{ { 0,1 },{ 1 } },
+		{ { 1,0 },{ 1 } },
+		{ { 1,1 },{ 0 } }
+	};
+	std::vector<Sample<>> functionSamples(512);
+	srand(0);
+	for (auto& s : functionSamples) {
+		double x = double(rand()) / RAND_MAX;
+		s = { { x },{ 0.5 + 0.3*sin(42 * x) } };
+	}
+
+	bool passed = true;
+	clock_t dynamicTime = 0, staticTime = 0;
+	for (int i = 0; i < 20; i++) {
+		srand(i);
+		NetLearner<> dynamicXor(Network<>({ 2, 10, 1 }, 1));
+		srand(i);
+		typedef StaticNetwork<double, 2, 10, 1> XorNetwork;
+		NetLearner<XorNetwork> staticXor(XorNetwork(1));
+		clock_t start = clock();
+		double dynamicError = dynamicXor.learn(xorSamples, 1000, -1, 10);
+		dynamicTime += clock() - start; start = clock();
+		double staticError = staticXor.learn(xorSamples, 1000, -1, 10);
+		staticTime += clock() - start;
+		passed &= std::abs(dynamicError - staticError) <= 1e-6 * (1 + dynamicError);
+	}
+	check("StaticNetwork learns the XOR as Network", passed);
+	std::cout << "(" << (staticTime * 1000.0 / CLOCKS_PER_SEC) << " ms instead of "
+		<< (dynamicTime * 1000.0 / CLOCKS_PER_SEC) << " ms)" << std::endl;
+
+	srand(1);
+	NetLearner<> dynamicFunction(Network<>({ 1,10,10,1 }));
+	srand(1);
+	typedef StaticNetwork<double, 1, 10, 10, 1> FunctionNetwork;
+	NetLearner<FunctionNetwork> staticFunction((FunctionNetwork()));
+	double dynamicError = dynamicFunction.learn(functionSamples, 100, -1, 0.1);
+	double staticError = staticFunction.learn(functionSamples, 100, -1, 0.1);
+	bool sameFunction = std::abs(dynamicError - staticError) <= 1e-6 * (1 + dynamicError);
+	for (double x = 0; x <= 1; x += 0.125) {
+		sameFunction &= std::abs(dynamicFunction.apply({ x })[0] - staticFunction.apply({ x })[0]) <= 1e-6;
+	}
+	return check("StaticNetwork learns a 1D function as Network", sameFunction) && passed;
+}
+
+// StreamingDetector against PyramidDetector::detect on every frame : a square moving over a still background, the other
+// windows keep their confidence (without tolerance, the maps are the same)
+bool testStreamingDetector() {
+
+	int W = 160, H = 120, w = 16, h = 12;
+	srand(0);
+	Network<float> net({ w*h, 4, 1 }, 1);
+	PyramidDetector<float> detector(net, w, h, [](const float*, const float* output) { return double(output[0]); });
+	StreamingDetector<float> stream(detector, 16, 0, 5);
+	cv::Mat background(cv::Size(W, H), CV_8UC1);
+	for (int i = 0; i < W*H; i++) { background.data[i] = uchar(rand() % 64); }
+
+	bool passed = true;
+	double updated = 0;
+	for (int f = 0; f < 10; f++) {
+		cv::Mat frame(cv::Size(W, H), CV_8UC1);
+		std::copy(background.data, background.data + W*H, frame.data);
+		for (int y = 20 + 4 * f; y < 40 + 4 * f; y++) {
+			for (int x = 10 + 12 * f; x < 30 + 12 * f; x++) { frame.data[y*W + x] = 200; }
+		}
+		std::vector<cv::Mat> streamed, full;
+		std::vector<Detection> found = stream.detect(frame, 0.5, 8, 0, &streamed);
+		passed &= detector.detect(frame, 0.5, 8, 0, &full).size() == found.size() && streamed.size() == full.size();
+		for (int s = 0; s < streamed.size() && passed; s++) {
+			const double* a = (const double*)streamed[s].data, *b = (const double*)full[s].data;
+			passed &= std::equal(a, a + streamed[s].size().width * streamed[s].size().height, b);
+		}
+		if (f > 0) { updated += stream.lastUpdate(); }
+	}
+	std::cout << "(" << int(100 * updated / 9) << "% of the windows scored per frame)" << std::endl;
+	return check("StreamingDetector gives the maps of PyramidDetector", passed);
+}
+
 void testAll() {
 
 	//test1DFunction([](double x) { return x*x; });
 	//test1DFunction([](double x) { return 0.5+0.3*sin(42*x); });
 	//test1DFunction([](double x) { return x < 0.5 ? 0.2 : 0.7; });
 	test1DFunction([](double x) { return 0.5 + 0.3*sin(1 / pow(1-x, 2)); });
-}
\ No newline at end of file
+}
+
+// checks of the learners and of their kernels against reference implementations
+bool testCorrectness() {
+
+	bool passed = true;
+	passed &= testKernels();
+	passed &= testBatchedNetwork();
+	passed &= testParallelTraining();
+	passed &= testModelFile();
+	passed &= testIdxFile();
+	passed &= testImageCache();
+	passed &= testNonMaximumSuppression();
+	passed &= testNeighborIndex();
+	passed &= testStaticNetwork();
+	passed &= testStreamingDetector();
+	return passed;
+}
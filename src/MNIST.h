@@ -1,34 +1,21 @@
 #pragma once
 
 #include <string>
-#include <fstream>
 #include <iostream>
+#include <stdexcept>
 
+#include "Convolution.h"
+#include "Detection.h"
+#include "Idx.h"
 #include "Learning.h"
 
 typedef unsigned char uchar;
 
-int byteSwap(int src) {
-	int dst;
-	uchar* srcP = (uchar*)&src;
-	uchar* dstP = (uchar*)&dst;
-	int bytes = sizeof(int) / sizeof(uchar);
-	for (int i = 0; i < bytes; i++) {
-		dstP[i] = srcP[bytes - 1 - i];
-	}
-	return dst;
-}
-
-int readInt(std::fstream& src) {
-	int dst;
-	src.read((char*)&dst, sizeof(int));
-	return byteSwap(dst);
-}
-
 // returns the index of the class with the highest probability
-int maxProb(const std::vector<double>& probs) {
+template<typename T>
+int maxProb(const std::vector<T>& probs) {
 
-	double bestProb = 0; int bestClass;
+	T bestProb = 0; int bestClass;
 	for (int i = 0; i < probs.size(); i++) {
 		if (probs[i] > bestProb) {
 			bestProb = probs[i];
@@ -40,108 +27,69 @@ int maxProb(const std::vector<double>& probs) {
 
 // classifying hand writen digits ffrom the MNIST dataset
 // http://yann.lecun.com/exdb/mnist/
-void learnMNIST(std::string imagesFileName, std::string labelsFileName) {
-
-	// loading the images
-	std::fstream imagesFile(imagesFileName, std::ios::in | std::ios::binary);
-	if (!imagesFile.is_open()) { std::cerr << "can't open " << imagesFileName.c_str() << std::endl; return; }
-
-	// loading the labels file
-	std::fstream labelsFile(labelsFileName, std::ios::in | std::ios::binary);
-	if (!labelsFile.is_open()) { std::cerr << "can't open " << labelsFileName.c_str() << std::endl; return; }
-
-	// header of the images file
-	int magicNumber = readInt(imagesFile),
-		nbOfImages = readInt(imagesFile),
-		nbRows = readInt(imagesFile),
-		nbColumns = readInt(imagesFile);
-
-	// header of the labels file
-	int magicNumber2 = readInt(labelsFile),
-		nbLabels = readInt(labelsFile);
-
-	// all sample digits
-	std::vector<Sample> samples(nbOfImages);
-
-	// parsing both files
-	for (int i = 0; i < nbOfImages; i++) {
-
-		// image pixels
-		std::vector<uchar> pixels(nbRows*nbColumns);
-		imagesFile.read((char*)pixels.data(), nbRows*nbColumns);
-
-		// label
-		char label;
-		labelsFile.read(&label, 1);
-
-		Sample& s = samples[i];
-
-		s = {
-			std::vector<double>(nbRows*nbColumns), // image size
-			std::vector<double>(10,0) // ten digits
-		};
-
-		// converting pixels to double
-		for (int j = 0; j < nbRows*nbColumns; j++) {
-			s.input[j] = pixels[j] / 255.0;
-		}
-
-		s.output[label] = 1.0;
-
+// (T is the scalar type of the samples and of the classifier)
+// without the t10k test files, the test samples are taken from the training files
+template<typename T = float>
+void learnMNIST(std::string imagesFileName, std::string labelsFileName,
+	std::string testImagesFileName = "", std::string testLabelsFileName = "") {
+
+	// mapping the files : the pixels are read from the files, when the samples are used
+	Dataset<T> samples(784, 10), testSamples(784, 10);
+	bool hasTestFiles = !testImagesFileName.empty() && !testLabelsFileName.empty();
+	try {
+		samples = loadMNIST<T>(imagesFileName, labelsFileName);
+		if (hasTestFiles) { testSamples = loadMNIST<T>(testImagesFileName, testLabelsFileName); }
 	}
+	catch (const std::runtime_error& e) { std::cerr << e.what() << std::endl; return; }
+	int nbRows = 28, nbColumns = 28;
 
-#if 0	// adding images randomly offseted
-	for (int i = 0; i < nbOfImages; i++) {
-
-		int offX = (1 - 2*double(rand()) / RAND_MAX) * nbColumns;
-		int offY = (1 - 2 * double(rand()) / RAND_MAX) * nbRows;
-		// the translation must be big enough
-		if (offX*offX + offY*offY < nbRows*nbColumns / 16) { continue; }
-
-		int j = rand() % nbOfImages;
-
-		std::vector<double>& original = samples[j].input;
-		std::vector<double> input(nbRows*nbColumns);
-		for (int y = 0; y < nbRows; y++) {
-			for (int x = 0; x < nbColumns; x++) {
-				if(
-					x+offX < 0 || x+offX >= nbColumns
-					|| y+offY < 0 || y+offY >= nbRows
-				) { continue; }
-				input[y*nbColumns + x] = original[(y + offY)*nbColumns + x + offX];
-			}
-		}
-		samples.push_back({ input, std::vector<double>(10,0) });
+	// learning the dataset
+	std::mt19937 random(rand());
+	samples.shuffle(random); // (only permutes indices)
+	if (!hasTestFiles) {
+		int learnSize = (samples.size() * 80) / 100;
+		int testSize = min<int>(1.1 * learnSize, samples.size()) - learnSize;
+		testSamples = samples.subset(learnSize, testSize);
+		samples = samples.subset(0, learnSize);
 	}
+	NetLearner<T> classifier(Network<T>({ nbRows*nbColumns, 10 }, 0));
+
+#if 0	// mini-batches of randomly offseted digits : made on the fly from the mapped pixels, while the previous batch is learnt
+	BatchLoader<T> loader(samples, 32, 3, 2);
+	loader.setAugmentation({ nbColumns, nbRows, 1, 4, false, 0 });
 #endif
 
-	// learning the dataset
-	std::random_shuffle(samples.begin(), samples.end());
-	int learnSize = (samples.size() * 80) / 100;
-	std::vector<Sample> learningSamples(samples.begin(), samples.begin() + learnSize);
-	NetLearner classifier(Network({ nbRows*nbColumns, 10 }, 0));
+	// the testing samples, in a matrix for the batch inference
+	int testSize = testSamples.size();
+	std::vector<T> testInputs(testSize * nbRows*nbColumns), testResults(testSize * 10);
+	testSamples.copyInputs(0, testSize, testInputs.data());
 
 	while (true) {
-		classifier.learn(learningSamples, 1, 0);
+#if 0
+		classifier.learn(loader, 1, 0.1);
+#else
+		classifier.learn(samples, 1, 0);
+#endif
 
 #include <opencv2\opencv.hpp>
 
 		// testing the classifier
 		int errors = 0;
-		int testSize = min<int>(1.1 * learnSize, samples.size()) - learnSize;
-		for (int i = learnSize; i < learnSize + testSize; i++) {
+		std::vector<T> result(10);
+		classifier.applyBatch(testInputs.data(), testResults.data(), testSize);
+		for (int i = 0; i < testSize; i++) {
 
-			cv::Mat im(cv::Size(nbColumns, nbRows), CV_64FC1);
-			const Sample& s = samples[i];
-			std::copy(s.input.begin(), s.input.end(), (double*)im.data);
+			cv::Mat im(cv::Size(nbColumns, nbRows), cv::DataType<T>::type);
+			const T* input = testInputs.data() + i * nbRows*nbColumns;
+			std::copy(input, input + nbRows*nbColumns, (T*)im.data);
 
 			// results of the classification
-			std::vector<double> result = classifier.apply(s.input);
+			std::copy(testResults.begin() + i * 10, testResults.begin() + (i + 1) * 10, result.begin());
 			int bestClass = maxProb(result);
-			if (bestClass != maxProb(s.output)) { errors++; }
+			if (bestClass != testSamples.label(i)) { errors++; }
 
 #if 0 // displaying the result
-			std::cout << "classified as " << bestClass << "; real class is " << maxProb(s.output) << std::endl;
+			std::cout << "classified as " << bestClass << "; real class is " << testSamples.label(i) << std::endl;
 			cv::resize(im, im, cv::Size(256, 256), 0, 0, cv::INTER_NEAREST);
 			cv::imshow("digit", im); cv::waitKey();
 #endif
@@ -151,14 +99,14 @@ void learnMNIST(std::string imagesFileName, std::string labelsFileName) {
 
 		// display the net coeffs for each class (in a row)
 		cv::Mat coeffsViz;
-		double* coeffsP = (double*)classifier.net.synapses[0].coefficients.data();
+		T* coeffsP = (T*)classifier.net.synapses[0].coefficients.data();
 		std::vector<cv::Mat> coeffs;
 		for (int i = 0; i < 10; i++) {
-			cv::Mat coeff(cv::Size(nbColumns, nbRows), CV_64FC1);
-			std::copy( // dont forget the bias
-				coeffsP + i + i*(nbRows*nbColumns),
-				coeffsP + i + (i + 1)*(nbRows*nbColumns),
-				((double*)coeff.data)
+			cv::Mat coeff(cv::Size(nbColumns, nbRows), cv::DataType<T>::type);
+			std::copy( // rows are padded to the SIMD width
+				coeffsP + i*classifier.net.synapses[0].stride,
+				coeffsP + i*classifier.net.synapses[0].stride + nbRows*nbColumns,
+				((T*)coeff.data)
 			);
 			coeffs.push_back(coeff);
 		}
@@ -181,82 +129,53 @@ void learnMNIST(std::string imagesFileName, std::string labelsFileName) {
 		cv::imshow("image", src); cv::waitKey(16);
 		int w = src.size().width, h = src.size().height;
 
-		// where to stock the results of the classifier
-		struct Result {
-			int foundClass;
-			double confidence; // the higher, the better
-		};
-		std::vector<Result> results((w - nbColumns)*(h - nbRows)); // per pixel
+		std::vector<T> image(w*h), classes(10);
+		for (int i = 0; i < w*h; i++) { image[i] = src.data[i*src.channels()] / T(255); }
 
-		// Convolving the classifier with the image
-		cv::Mat segmentation(cv::Size(w - nbColumns, h - nbRows), CV_64FC1);
-		double* segP = (double*)segmentation.data;
-		for (int y = 0; y < h - nbRows; y++) {
-			for (int x = 0; x < w - nbColumns; x++) {
+		// the classifier over all the windows at once : its first layer convolved with the whole image (by im2col or FFT),
+		// then the other layers at each position
+		int convWidth = std::max(w - nbColumns + 1, 0), convHeight = std::max(h - nbRows + 1, 0);
+		std::vector<T> convolution(size_t(convWidth) * convHeight * 10);
+		ThreadPool pool;
+		applyConvolution(classifier.net, image.data(), w, h, nbColumns, nbRows, convolution.data(), pool);
 
-				// input patch
-				std::vector<double> input(nbRows*nbColumns);
-				for (int y2 = 0; y2 < nbRows; y2++) {
-					for (int x2 = 0; x2 < nbColumns; x2++) {
-						input[y2*nbColumns + x2] =
-							src.data[((y+y2)*w+x+x2)*src.channels()] / 255.0;
-					}
-				}
+		// the probability of 3 at each position, from the map
+		cv::Mat segmentation(cv::Size(convWidth, convHeight), CV_64FC1);
+		double* segP = (double*)segmentation.data;
+		for (size_t i = 0; i < size_t(convWidth) * convHeight; i++) { segP[i] = convolution[i * 10 + 3]; }
+		segmentation.convertTo(segmentation, CV_8U, 255);
+		cv::applyColorMap(segmentation, segmentation, cv::COLORMAP_BONE);
+		cv::imshow("probabilities of 3", segmentation); cv::waitKey(16);
 
-				// output classes
-				std::vector<double> classes = classifier.apply(input);
-				segP[y*(w - nbColumns) + x] = classes[3];
+		// scoring the windows from that map : the class of highest probability, by its margin over the second one
+		auto scorer = [&](std::vector<Detection>& windows) {
+			for (Detection& d : windows) {
+				const T* probs = convolution.data() + (size_t(d.y) * convWidth + d.x) * 10;
+				std::copy(probs, probs + 10, classes.begin());
 				int bestClass = maxProb(classes);
 				double bestProb = classes[bestClass];
 				classes[bestClass] = 0;
 				double secondBestProb = classes[maxProb(classes)];
-				results[y*(w - nbColumns) + x] = { bestClass, bestProb - secondBestProb };
+				d.label = bestClass;
+				d.confidence = bestProb - secondBestProb;
 			}
-		}
-		segmentation.convertTo(segmentation, CV_8U, 255);
-		cv::applyColorMap(segmentation, segmentation, cv::COLORMAP_BONE);
-		cv::imshow("probabilities of 3", segmentation); cv::waitKey(16);
+		};
+
+		// the best non-overlapping windows : a coarse scan, refined around its local maximums
+		std::vector<Detection> digits = detect(w, h, nbColumns, nbRows, scorer, 8, 4);
 
-		// finding the maximums in the result image
-		double bestConfidence;
-		int i = 0;
+		// displaying the results (the gray image in the red channel)
 		std::vector<cv::Mat> channels = { cv::Mat(src.size(),CV_8UC1),
 			cv::Mat(src.size(),CV_8UC1), src };
 		channels[0] = 0; channels[1] = 0;
-		cv::merge( channels, src); // display the gray image in the red channel
-		do {
-			int bestX, bestY, bestClass;
-			bestConfidence = 0;
-
-			// searching for the best result among all pixels
-			for (int y = 0; y < h - nbRows; y++) {
-				for (int x = 0; x < w - nbColumns; x++) {
-					Result& r = results[y*(w - nbColumns) + x];
-					double confidence = r.confidence;
-					if (confidence > bestConfidence) {
-						bestConfidence = confidence;
-						bestX = x;
-						bestY = y;
-						bestClass = r.foundClass;
-					}
-				}
-			}
-
-			// Displaying the result
-			cv::rectangle(src, cv::Rect(bestX, bestY, nbColumns, nbRows), { 0,255,0 });
-			std::stringstream ss; ss << bestClass
-				<< " : " << int(100 * bestConfidence) << "%";
-			cv::putText(src, ss.str(), cv::Point(bestX - 12, bestY + nbRows - 1),
+		cv::merge( channels, src);
+		for (const Detection& d : digits) {
+			cv::rectangle(src, cv::Rect(d.x, d.y, d.width, d.height), { 0,255,0 });
+			std::stringstream ss; ss << d.label
+				<< " : " << int(100 * d.confidence) << "%";
+			cv::putText(src, ss.str(), cv::Point(d.x - 12, d.y + d.height - 1),
 				cv::FONT_HERSHEY_PLAIN, 1, { 0,255,0 });
-
-			// Removing neighboring results (they might be the same digit)
-			for (int y = max(0, bestY - nbRows); y < min(h - nbRows, bestY + nbRows); y++) {
-				for (int x = max(0, bestX - nbColumns); x < min(w - nbColumns, bestX + nbColumns); x++) {
-					results[y*(w - nbColumns) + x].confidence = 0;
-				}
-			}
-			i++;
-		} while (i < 8); // only display the best results
+		}
 
 		cv::imshow("Digits found", src); cv::waitKey(16);
 		cv::waitKey();
@@ -1,12 +1,17 @@
 
 #include "ImageTest.h"
+#include "LearningTests.h"
 #include "MNIST.h"
 
 int main() {
 
+	// the checks of the learners first : the program fails if one of them does
+	if (!testCorrectness()) { return 1; }
+
 	//learnImage("../../data/blender.png");
 	learnImageFilter("../../data/kid.png", "../../data/manga.png");
 
-	//learnMNIST("../../data/train-images.idx3-ubyte", "../../data/train-labels.idx1-ubyte");
+	//learnMNIST("../../data/train-images.idx3-ubyte", "../../data/train-labels.idx1-ubyte",
+	//	"../../data/t10k-images.idx3-ubyte", "../../data/t10k-labels.idx1-ubyte");
 
 }
\ No newline at end of file
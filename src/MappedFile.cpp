@@ -0,0 +1,54 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& fileName) : address(NULL), length(0) {
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE) { throw std::runtime_error("can't open " + fileName); }
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size)) { CloseHandle(handle); throw std::runtime_error("can't read the size of " + fileName); }
+	length = size_t(size.QuadPart);
+	if (length == 0) { CloseHandle(handle); return; } // (empty files can't be mapped)
+
+	HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(handle); // (the mapping keeps the file open)
+	if (mapping == NULL) { throw std::runtime_error("can't map " + fileName); }
+	address = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping); // (the view keeps the mapping)
+	if (address == NULL) { throw std::runtime_error("can't map " + fileName); }
+#else
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) { throw std::runtime_error("can't open " + fileName); }
+	struct stat st;
+	if (fstat(fd, &st) != 0) { close(fd); throw std::runtime_error("can't read the size of " + fileName); }
+	length = size_t(st.st_size);
+	if (length == 0) { close(fd); return; }
+
+	void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd); // (the mapping keeps the file open)
+	if (p == MAP_FAILED) { throw std::runtime_error("can't map " + fileName); }
+	address = (unsigned char*)p;
+#endif
+}
+
+MappedFile::~MappedFile() {
+
+	if (address == NULL) { return; }
+#ifdef _WIN32
+	UnmapViewOfFile(address);
+#else
+	munmap(address, length);
+#endif
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "Kernels.h"
+
+// file mapped in memory, copy-on-write : the pages are shared by all processes mapping the same file,
+// until one of them writes to them (its changes are private, and never written back to the file)
+class MappedFile
+{
+	unsigned char* address; // NULL for empty files
+	size_t length;
+
+public:
+	MappedFile(const std::string& fileName); // throws std::runtime_error if the file can't be mapped
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	unsigned char* data() { return address; }
+	const unsigned char* data() const { return address; }
+	size_t size() const { return length; }
+};
+
+// array of T, which either owns an aligned buffer or views a region of a mapped file (and keeps the file mapped)
+// copies always own their values, moves keep the view
+template<typename T>
+class MappedArray
+{
+	AlignedVector<T> owned; // empty for views
+	std::shared_ptr<MappedFile> file; // NULL if the values are owned
+	T* first;
+	size_t count;
+
+public:
+	MappedArray() : first(NULL), count(0) {}
+	MappedArray(size_t n, T value) : owned(n, value), first(owned.data()), count(n) {}
+	MappedArray(std::shared_ptr<MappedFile> file, size_t offset, size_t n) : // offset in bytes, aligned on T
+		file(file), first((T*)(file->data() + offset)), count(n) {}
+	MappedArray(const MappedArray& src) : owned(src.first, src.first + src.count), first(owned.data()), count(src.count) {}
+	MappedArray(MappedArray&& src) noexcept :
+		owned(std::move(src.owned)), file(std::move(src.file)), first(src.first), count(src.count) { src.first = NULL; src.count = 0; }
+	MappedArray& operator=(MappedArray src) { // (by copy or by move)
+
+		std::swap(owned, src.owned);
+		std::swap(file, src.file);
+		std::swap(first, src.first);
+		std::swap(count, src.count);
+		return *this;
+	}
+
+	bool isMapped() const { return file != nullptr; }
+	size_t size() const { return count; }
+	T* data() { return first; }
+	const T* data() const { return first; }
+	T& operator[](size_t i) { return first[i]; }
+	const T& operator[](size_t i) const { return first[i]; }
+	T* begin() { return first; }
+	T* end() { return first + count; }
+	const T* begin() const { return first; }
+	const T* end() const { return first + count; }
+};
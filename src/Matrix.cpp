@@ -0,0 +1,77 @@
+#include "Matrix.h"
+#include "Kernels.h"
+
+#include <algorithm>
+
+// block sizes (in elements) : a block of A and a block of B fit together in L1/L2
+static const int blockM = 64, blockN = 64, blockK = 256;
+
+template<typename T, typename Acc>
+void gemmNT(int m, int n, int k, const T* A, int lda, const T* B, int ldb, T* C, int ldc) {
+
+	for (int i0 = 0; i0 < m; i0 += blockM) {
+		int i1 = std::min(i0 + blockM, m);
+		for (int j0 = 0; j0 < n; j0 += blockN) {
+			int j1 = std::min(j0 + blockN, n);
+			for (int p0 = 0; p0 < k; p0 += blockK) {
+				int p1 = std::min(p0 + blockK, k);
+				for (int i = i0; i < i1; i++) {
+					const T* a = A + i*lda;
+					T* c = C + i*ldc;
+					for (int j = j0; j < j1; j++) { // dot product of two contiguous rows
+						c[j] += Kernels::dot<Acc>(a + p0, B + j*ldb + p0, p1 - p0);
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename T>
+void gemmNN(int m, int n, int k, const T* A, int lda, const T* B, int ldb, T* C, int ldc) {
+
+	for (int i0 = 0; i0 < m; i0 += blockM) {
+		int i1 = std::min(i0 + blockM, m);
+		for (int p0 = 0; p0 < k; p0 += blockK) {
+			int p1 = std::min(p0 + blockK, k);
+			for (int j0 = 0; j0 < n; j0 += blockK) {
+				int j1 = std::min(j0 + blockK, n);
+				for (int i = i0; i < i1; i++) {
+					T* c = C + i*ldc;
+					for (int p = p0; p < p1; p++) { // adding a scaled row of B to the row of C
+						Kernels::axpy(A[i*lda + p], B + p*ldb + j0, c + j0, j1 - j0);
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename T, typename Acc>
+void gemmTN(int m, int n, int k, const T* A, int lda, const T* B, int ldb, Acc* C, int ldc) {
+
+	for (int i0 = 0; i0 < m; i0 += blockM) {
+		int i1 = std::min(i0 + blockM, m);
+		for (int j0 = 0; j0 < n; j0 += blockK) {
+			int j1 = std::min(j0 + blockK, n);
+			for (int p = 0; p < k; p++) { // one rank-1 update per row of A and B
+				const T* a = A + p*lda;
+				const T* b = B + p*ldb;
+				for (int i = i0; i < i1; i++) {
+					if (a[i] == 0) { continue; }
+					Kernels::axpy(Acc(a[i]), b + j0, C + i*ldc + j0, j1 - j0);
+				}
+			}
+		}
+	}
+}
+
+
+template void gemmNT<double, double>(int, int, int, const double*, int, const double*, int, double*, int);
+template void gemmNT<float, float>(int, int, int, const float*, int, const float*, int, float*, int);
+template void gemmNT<float, double>(int, int, int, const float*, int, const float*, int, float*, int);
+template void gemmNN<double>(int, int, int, const double*, int, const double*, int, double*, int);
+template void gemmNN<float>(int, int, int, const float*, int, const float*, int, float*, int);
+template void gemmTN<double, double>(int, int, int, const double*, int, const double*, int, double*, int);
+template void gemmTN<float, float>(int, int, int, const float*, int, const float*, int, float*, int);
+template void gemmTN<float, double>(int, int, int, const float*, int, const float*, int, double*, int);
\ No newline at end of file
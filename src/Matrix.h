@@ -0,0 +1,29 @@
+#pragma once
+
+// dense matrix products on row-major matrices, blocked to keep the working set in cache
+// (ld* are the row strides, all products accumulate into C)
+// instantiated for <double,double>, <float,float> and <float,double> (float matrices, double accumulators)
+
+// C (m x n) += A (m x k) * B^T, with B (n x k) ; the dot products are accumulated in Acc
+template<typename T, typename Acc>
+void gemmNT(int m, int n, int k,
+	const T* A, int lda,
+	const T* B, int ldb,
+	T* C, int ldc
+);
+
+// C (m x n) += A (m x k) * B, with B (k x n)
+template<typename T>
+void gemmNN(int m, int n, int k,
+	const T* A, int lda,
+	const T* B, int ldb,
+	T* C, int ldc
+);
+
+// C (m x n) += A^T * B, with A (k x m) and B (k x n) ; C holds the accumulators
+template<typename T, typename Acc>
+void gemmTN(int m, int n, int k,
+	const T* A, int lda,
+	const T* B, int ldb,
+	Acc* C, int ldc
+);
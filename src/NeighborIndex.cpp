@@ -0,0 +1,164 @@
+#include "NeighborIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+// points of the leaves
+static const int leafSize = 8;
+
+template<typename T>
+double NeighborIndex<T>::distance2(const T* a, const T* b) const {
+
+	double dist = 0;
+	for (int i = 0; i < dim; i++) {
+		double diff = double(a[i]) - double(b[i]);
+		dist += diff*diff;
+	}
+	return dist;
+}
+
+template<typename T>
+void NeighborIndex<T>::build(const T* src, int count, int dimension, Type type) {
+
+	dim = dimension;
+	vantagePoints = type == VantagePointTree || (type == Auto && dimension > maxKdDimension);
+	points.assign(src, src + size_t(count) * dimension);
+	indices.resize(count);
+	for (int i = 0; i < count; i++) { indices[i] = i; }
+	nodes.clear();
+	if (count == 0) { return; }
+
+	// the tree is built on the indices, then the points are sorted in their order
+	if (vantagePoints) { buildVp(0, count); }
+	else { buildKd(0, count); }
+	std::vector<T> sorted(points.size());
+	for (int i = 0; i < count; i++) {
+		std::copy(src + size_t(indices[i]) * dim, src + size_t(indices[i] + 1) * dim, sorted.begin() + size_t(i) * dim);
+	}
+	points.swap(sorted);
+}
+
+template<typename T>
+int NeighborIndex<T>::buildKd(int begin, int end) {
+
+	int n = nodes.size();
+	nodes.push_back({ begin, end, -1, -1, 0, 0 });
+	if (end - begin <= leafSize) { return n; }
+
+	// the axis of largest spread, split at its median
+	int axis = 0; double bestSpread = -1;
+	for (int a = 0; a < dim; a++) {
+		T low = points[size_t(indices[begin]) * dim + a], high = low;
+		for (int i = begin + 1; i < end; i++) {
+			T v = points[size_t(indices[i]) * dim + a];
+			low = std::min(low, v); high = std::max(high, v);
+		}
+		if (double(high) - double(low) > bestSpread) { bestSpread = double(high) - double(low); axis = a; }
+	}
+	int mid = begin + (end - begin) / 2;
+	std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+		[&](int a, int b) { return points[size_t(a) * dim + axis] < points[size_t(b) * dim + axis]; });
+
+	double split = points[size_t(indices[mid]) * dim + axis];
+	int left = buildKd(begin, mid), right = buildKd(mid, end);
+	Node& node = nodes[n];
+	node.left = left; node.right = right;
+	node.axis = axis;
+	node.split = split;
+	return n;
+}
+
+template<typename T>
+int NeighborIndex<T>::buildVp(int begin, int end) {
+
+	int n = nodes.size();
+	nodes.push_back({ begin, end, -1, -1, 0, 0 });
+	if (end - begin <= leafSize) { return n; }
+
+	// the vantage point (the point farthest from the middle one, a corner of the set), and the others by their
+	// distance to it, split at the median
+	const T* middle = points.data() + size_t(indices[begin + (end - begin) / 2]) * dim;
+	int farthest = begin; double farthestDist = -1;
+	for (int i = begin; i < end; i++) {
+		double d = distance2(middle, points.data() + size_t(indices[i]) * dim);
+		if (d > farthestDist) { farthestDist = d; farthest = i; }
+	}
+	std::swap(indices[begin], indices[farthest]);
+	const T* vantage = points.data() + size_t(indices[begin]) * dim;
+	int mid = begin + 1 + (end - begin - 1) / 2;
+	std::nth_element(indices.begin() + begin + 1, indices.begin() + mid, indices.begin() + end, [&](int a, int b) {
+		return distance2(vantage, points.data() + size_t(a) * dim) < distance2(vantage, points.data() + size_t(b) * dim);
+	});
+
+	double split = std::sqrt(distance2(vantage, points.data() + size_t(indices[mid]) * dim));
+	int left = buildVp(begin + 1, mid), right = buildVp(mid, end);
+	Node& node = nodes[n];
+	node.left = left; node.right = right;
+	node.split = split;
+	return n;
+}
+
+// adds point i to the heap of the k best neighbors (the farthest one on top)
+template<typename T>
+void NeighborIndex<T>::consider(const T* query, int i, int k, std::vector<Neighbor>& heap) const {
+
+	double dist = distance2(query, points.data() + size_t(i) * dim);
+	auto closer = [](const Neighbor& a, const Neighbor& b) { return a.distance < b.distance; };
+	if (heap.size() < k) {
+		heap.push_back({ dist, indices[i] });
+		std::push_heap(heap.begin(), heap.end(), closer);
+	}
+	else if (dist < heap.front().distance) {
+		std::pop_heap(heap.begin(), heap.end(), closer);
+		heap.back() = { dist, indices[i] };
+		std::push_heap(heap.begin(), heap.end(), closer);
+	}
+}
+
+template<typename T>
+void NeighborIndex<T>::searchKd(int n, const T* query, int k, std::vector<Neighbor>& heap) const {
+
+	const Node& node = nodes[n];
+	if (node.left < 0) {
+		for (int i = node.begin; i < node.end; i++) { consider(query, i, k, heap); }
+		return;
+	}
+
+	// the side of the query first : the other one is at least as far as the split
+	double diff = double(query[node.axis]) - node.split;
+	searchKd(diff < 0 ? node.left : node.right, query, k, heap);
+	if (heap.size() < k || diff*diff < heap.front().distance) { searchKd(diff < 0 ? node.right : node.left, query, k, heap); }
+}
+
+template<typename T>
+void NeighborIndex<T>::searchVp(int n, const T* query, int k, std::vector<Neighbor>& heap) const {
+
+	const Node& node = nodes[n];
+	if (node.left < 0) {
+		for (int i = node.begin; i < node.end; i++) { consider(query, i, k, heap); }
+		return;
+	}
+	consider(query, node.begin, k, heap);
+
+	// the side of the query first : by the triangle inequality, the points of the other one are at least |d - split| away
+	// (with a margin for the rounding errors)
+	double d = std::sqrt(distance2(query, points.data() + size_t(node.begin) * dim));
+	bool inside = d < node.split;
+	searchVp(inside ? node.left : node.right, query, k, heap);
+	double bound = std::abs(d - node.split) * (1 - 1e-9);
+	if (heap.size() < k || bound*bound < heap.front().distance) { searchVp(inside ? node.right : node.left, query, k, heap); }
+}
+
+template<typename T>
+void NeighborIndex<T>::search(const T* query, int k, std::vector<Neighbor>& neighbors) const {
+
+	neighbors.clear();
+	if (nodes.empty() || k <= 0) { return; }
+	neighbors.reserve(std::min(k, size()));
+	if (vantagePoints) { searchVp(0, query, k, neighbors); }
+	else { searchKd(0, query, k, neighbors); }
+	std::sort_heap(neighbors.begin(), neighbors.end(), [](const Neighbor& a, const Neighbor& b) { return a.distance < b.distance; });
+}
+
+template class NeighborIndex<double>;
+template class NeighborIndex<float>;
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+// exact nearest neighbors of points (count x dimension values, row-major), by branch and bound in a tree of the points :
+// a KD-tree (split at the median of the coordinate of largest spread) for low dimensions, or a vantage-point tree (split
+// at the median distance to a point) for higher ones, whose bounds don't degrade with the dimension
+template<typename T>
+class NeighborIndex
+{
+public:
+	enum Type { Auto, KdTree, VantagePointTree }; // Auto : a KD-tree up to maxKdDimension
+	static const int maxKdDimension = 12;
+
+	struct Neighbor {
+		double distance; // squared
+		int index; // of the point, in the order they were given
+	};
+
+private:
+	struct Node {
+		int begin, end; // points of the node (for a vantage-point, the first one is the vantage point)
+		int left, right; // children (-1 for leaves) : below and above the split
+		int axis; // of the split, for a KD-tree
+		double split; // coordinate, or distance to the vantage point
+	};
+	int dim;
+	bool vantagePoints;
+	std::vector<T> points; // in the order of the tree, the points of each node are contiguous
+	std::vector<int> indices; // of the points in that order
+	std::vector<Node> nodes;
+
+	double distance2(const T* a, const T* b) const;
+	int buildKd(int begin, int end);
+	int buildVp(int begin, int end);
+	void consider(const T* query, int i, int k, std::vector<Neighbor>& heap) const;
+	void searchKd(int node, const T* query, int k, std::vector<Neighbor>& heap) const;
+	void searchVp(int node, const T* query, int k, std::vector<Neighbor>& heap) const;
+
+public:
+	NeighborIndex() : dim(0), vantagePoints(false) {}
+
+	void build(const T* points, int count, int dimension, Type type = Auto); // (copies the points)
+	int size() const { return indices.size(); }
+	int dimension() const { return dim; }
+	bool isKdTree() const { return !vantagePoints; }
+
+	// the k nearest points (or all of them if there are fewer), by increasing distance
+	void search(const T* query, int k, std::vector<Neighbor>& neighbors) const;
+};
@@ -1,86 +1,532 @@
 #include "NeuralNetwork.h"
+#include "Matrix.h"
 
-Network::Synapses::Synapses(int input, int output, double initCoeff) : inputLayer(input), outputLayer(output) {
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 
-	coefficients = vector<double>(input*output);
-	gradient = vector<double>(input*output, 0);
-	for (int i = 0; i < coefficients.size(); i++) { coefficients[i] = initCoeff*(1 - 2 * double(rand()) / RAND_MAX); }
+template<typename T, typename Acc>
+Network<T, Acc>::Synapses::Synapses(int input, int output, double initCoeff, Activation activation) :
+	inputLayer(input), outputLayer(output), stride(Kernels::paddedSize(input, sizeof(T))), activation(activation) {
+
+	coefficients = MappedArray<T>(output*stride, 0);
+	bias = MappedArray<T>(output, 0);
+	for (int o = 0; o < output; o++) {
+		for (int i = 0; i < input; i++) { set(i, o, T(initCoeff*(1 - 2 * double(rand()) / RAND_MAX))); }
+		bias[o] = T(-initCoeff*(1 - 2 * double(rand()) / RAND_MAX)); // (same draws as the former bias neuron of value -1)
+	}
+}
+
+template<typename T, typename Acc>
+Network<T, Acc>::Synapses::Synapses(int input, int output, Activation activation, MappedArray<T> coefficients, MappedArray<T> bias) :
+	inputLayer(input), outputLayer(output), stride(Kernels::paddedSize(input, sizeof(T))), activation(activation),
+	coefficients(std::move(coefficients)), bias(std::move(bias)) {}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::Synapses::allocateGradients() {
+
+	if (!gradient.empty()) { return; }
+	gradient = AlignedVector<Acc>(outputLayer*stride, 0);
+	biasGradient = AlignedVector<Acc>(outputLayer, 0);
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::Synapses::updateCoeffs(double learningRate) {
+
+	if (gradient.empty()) { return; } // nothing was backtracked
+	Kernels::axpy(Acc(learningRate), gradient.data(), coefficients.data(), coefficients.size());
+	Kernels::axpy(Acc(learningRate), biasGradient.data(), bias.data(), bias.size());
+	std::fill(gradient.begin(), gradient.end(), Acc(0));
+	std::fill(biasGradient.begin(), biasGradient.end(), Acc(0));
 }
 
-Network::Network(vector<int> layerSizes, double initCoeffs) : layers(), synapses() {
+template<typename T, typename Acc>
+Network<T, Acc>::Network(vector<int> layerSizes, double initCoeffs, vector<Activation> activations) : workspace(), synapses() {
 
-	for (int i = 0; i < layerSizes.size(); i++) {
-		vector<Neuron> layer = vector<Neuron>(layerSizes[i] + 1);
-		layer[layer.size() - 1].value = -1; // the bias neuron has a constant value of -1
-		if (i < layerSizes.size() - 1) {  // for every layer but the last :
+	for (int i = 0; i < layerSizes.size() - 1; i++) {  // for every layer but the last :
+		Activation activation = i < activations.size() ? activations[i] : Sigmoid;
+		synapses.push_back(Synapses(layerSizes[i], layerSizes[i + 1], initCoeffs, activation));
+	}
+	createLayers(layerSizes);
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::createLayers(const vector<int>& layerSizes) {
 
-			Synapses s = Synapses(layerSizes[i] + 1, layerSizes[i + 1], initCoeffs);  // don't forget the bias in the input layer !
-			synapses.push_back(s);
+	for (int size : layerSizes) {
+		workspace.layers.push_back({ size, Kernels::paddedSize(size, sizeof(T)), 0, 0, 0 }); // (the offsets are set by allocate)
+	}
+	workspace.capacity = 0;
+	allocate(workspace, 1);
+}
+
+template<typename T, typename Acc>
+typename Network<T, Acc>::Workspace Network<T, Acc>::createWorkspace(bool ownGradients) const {
+
+	Workspace ws;
+	ws.layers = workspace.layers;
+	ws.capacity = 0;
+	allocate(ws, 1);
+	if (ownGradients) {
+		for (const Synapses& s : synapses) {
+			ws.gradients.push_back(AlignedVector<Acc>(s.outputLayer * s.stride, 0));
+			ws.biasGradients.push_back(AlignedVector<Acc>(s.outputLayer, 0));
 		}
-		layers.push_back(layer);
 	}
+	return ws;
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::allocate(Workspace& ws, int batchSize) const {
+
+	ws.batchSize = batchSize;
+	if (batchSize <= ws.capacity) { return; }
+
+	// input, value and diff arrays of all layers, one after the other
+	size_t offset = 0;
+	for (Layer& layer : ws.layers) {
+		size_t size = size_t(batchSize) * layer.stride;
+		layer.input = offset; offset += size;
+		layer.value = offset; offset += size;
+		layer.diff = offset; offset += size;
+	}
+	ws.storage = AlignedVector<T>(offset, 0);
+	ws.capacity = batchSize;
 }
 
-void Network::setInput(const double* values) {
+template<typename T, typename Acc>
+void Network<T, Acc>::Workspace::addGradients(const Workspace& src) {
 
-	vector<Neuron>& inputLayer = layers[0];
-	for (int i = 0; i < inputLayer.size()-1; i++) { inputLayer[i].value = values[i]; }
+	for (int l = 0; l < gradients.size(); l++) {
+		Kernels::axpy(Acc(1), src.gradients[l].data(), gradients[l].data(), gradients[l].size());
+		Kernels::axpy(Acc(1), src.biasGradients[l].data(), biasGradients[l].data(), biasGradients[l].size());
+	}
 }
 
-void Network::activate() {
+template<typename T, typename Acc>
+void Network<T, Acc>::Workspace::clearGradients() {
 
-	for (int i = 1; i < layers.size(); i++) {  // for every layer but the input
+	for (auto& g : gradients) { std::fill(g.begin(), g.end(), Acc(0)); }
+	for (auto& g : biasGradients) { std::fill(g.begin(), g.end(), Acc(0)); }
+}
 
-		vector<Neuron>& layer = layers[i];
-		Synapses& synapse = synapses[i - 1]; // synapses between layer i-1 and i
-		vector<Neuron>& prevLayer = layers[i - 1];
-		for (int nextNeuron = 0; nextNeuron < layer.size() - 1; nextNeuron++) {
-			layer[nextNeuron].input = 0;
-			for (int prevNeuron = 0; prevNeuron < synapse.inputLayer; prevNeuron++) {
-				layer[nextNeuron].input += synapse.get(prevNeuron, nextNeuron) * prevLayer[prevNeuron].value;
-			}
-			layer[nextNeuron].value = sigmoid(layer[nextNeuron].input);
+template<typename T, typename Acc>
+void Network<T, Acc>::addGradients(const Workspace& ws) {
+
+	for (int l = 0; l < synapses.size(); l++) {
+		Synapses& s = synapses[l];
+		s.allocateGradients();
+		Kernels::axpy(Acc(1), ws.gradients[l].data(), s.gradient.data(), s.gradient.size());
+		Kernels::axpy(Acc(1), ws.biasGradients[l].data(), s.biasGradient.data(), s.biasGradient.size());
+	}
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::setInput(const T* values) {
+
+	allocate(workspace, 1);
+	std::copy(values, values + inputSize(), workspace.values(0));
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::activate() {
+
+	forward(workspace);
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::forward(Workspace& ws, int firstLayer) const {
+
+	for (int i = firstLayer; i < ws.layers.size(); i++) {  // for every layer but the input
+
+		const Layer& layer = ws.layers[i];
+		const Layer& prevLayer = ws.layers[i - 1];
+		const Synapses& synapse = synapses[i - 1]; // synapses between layer i-1 and i
+		T* in = ws.inputs(i);
+		T* value = ws.values(i);
+
+		// inputs = bias + prevValues * coefficients^T
+		for (int s = 0; s < ws.batchSize; s++) {
+			std::copy(synapse.bias.begin(), synapse.bias.end(), in + s * layer.stride);
+		}
+		gemmNT<T, Acc>(ws.batchSize, layer.size, prevLayer.size,
+			ws.values(i - 1), prevLayer.stride,
+			synapse.coefficients.data(), synapse.stride,
+			in, layer.stride
+		);
+		for (int s = 0; s < ws.batchSize; s++) {
+			applyActivation(synapse.activation, in + s * layer.stride, value + s * layer.stride, layer.size);
+		}
+	}
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::setDesiredOutput(const T* values) {
+
+	setDesiredOutputBatch(workspace, values);
+}
+
+template<typename T, typename Acc>
+vector<T> Network<T, Acc>::getOuput() {
+
+	const T* value = workspace.values(workspace.layers.size() - 1);
+	return vector<T>(value, value + outputSize());
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::update(double learningRate) {
+
+	for (auto& s : synapses) { s.updateCoeffs(learningRate); }
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::backtrack() {
+
+	backward(workspace);
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::backward(Workspace& ws) {
+
+	for (int l = ws.layers.size() - 2; l >= 0; l--) {
+		const Layer& layer = ws.layers[l]; // local input layer
+		Synapses& synapse = synapses[l];
+		const Layer& nextLayer = ws.layers[l + 1]; // local output layer
+		const T* nextDiff = ws.diffs(l + 1);
+		if (ws.gradients.empty()) { synapse.allocateGradients(); }
+		Acc* gradient = ws.gradients.empty() ? synapse.gradient.data() : ws.gradients[l].data();
+		Acc* biasGradient = ws.gradients.empty() ? synapse.biasGradient.data() : ws.biasGradients[l].data();
+
+		// gradient += nextDiffs^T * values : a single product for the whole batch
+		gemmTN<T, Acc>(synapse.outputLayer, synapse.inputLayer, ws.batchSize,
+			nextDiff, nextLayer.stride,
+			ws.values(l), layer.stride,
+			gradient, synapse.stride
+		);
+		for (int s = 0; s < ws.batchSize; s++) {
+			Kernels::axpy(Acc(1), nextDiff + s * nextLayer.stride, biasGradient, nextLayer.size);
 		}
+
+		if (l == 0) { break; } // the input layer doesn't need its diffs
+
+		// diffSums = nextDiffs * coefficients
+		T* diff = ws.diffs(l);
+		const T* value = ws.values(l);
+		std::fill(diff, diff + ws.batchSize * layer.stride, T(0));
+		gemmNN<T>(ws.batchSize, layer.size, nextLayer.size,
+			nextDiff, nextLayer.stride,
+			synapse.coefficients.data(), synapse.stride,
+			diff, layer.stride
+		);
+		for (int s = 0; s < ws.batchSize; s++) {
+			multiplyDerivative(synapses[l - 1].activation, value + s * layer.stride, diff + s * layer.stride, layer.size);
+		}
+	}
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::activateBatch(const T* inputs, int batchSize) {
+
+	activateBatch(workspace, inputs, batchSize);
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::activateBatch(Workspace& ws, const T* inputs, int batchSize) const {
+
+	allocate(ws, batchSize);
+	const Layer& inputLayer = ws.layers[0];
+	T* value = ws.values(0);
+	for (int s = 0; s < batchSize; s++) {
+		std::copy(inputs + s * inputLayer.size, inputs + (s + 1) * inputLayer.size, value + s * inputLayer.stride);
 	}
+	forward(ws);
 }
 
-void Network::setDesiredOutput(const double* values) {
+template<typename T, typename Acc>
+void Network<T, Acc>::setDesiredOutputBatch(const T* values) {
 
-	vector<Neuron>& outputLayer = layers[layers.size() - 1];
-	for (int i = 0; i < outputLayer.size() - 1; i++) {
-		outputLayer[i].diff = sigmoidDeriv(outputLayer[i].input) * (values[i] - outputLayer[i].value); // delta = g'(in) * (y - a)
+	setDesiredOutputBatch(workspace, values);
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::setDesiredOutputBatch(Workspace& ws, const T* values) const {
+
+	int l = ws.layers.size() - 1;
+	const Layer& outputLayer = ws.layers[l];
+	const T* value = ws.values(l);
+	T* diff = ws.diffs(l);
+	for (int s = 0; s < ws.batchSize; s++) {
+		for (int i = 0; i < outputLayer.size; i++) {
+			int n = s * outputLayer.stride + i;
+			diff[n] = values[s * outputLayer.size + i] - value[n];
+		}
+		// delta = g'(in) * (y - a)
+		multiplyDerivative(synapses[l - 1].activation, value + s * outputLayer.stride, diff + s * outputLayer.stride, outputLayer.size);
 	}
 }
 
-vector<double> Network::getOuput() {
+template<typename T, typename Acc>
+vector<T> Network<T, Acc>::getOutputBatch() {
 
-	vector<Neuron>& outputLayer = layers[layers.size() - 1];
-	vector<double> dst(outputLayer.size() - 1);
-	for (int i = 0; i < outputLayer.size() - 1; i++) {
-		dst[i] = outputLayer[i].value;
+	const Layer& outputLayer = workspace.layers.back();
+	const T* value = workspace.values(workspace.layers.size() - 1);
+	vector<T> dst(workspace.batchSize * outputLayer.size);
+	for (int s = 0; s < workspace.batchSize; s++) {
+		std::copy(value + s * outputLayer.stride, value + s * outputLayer.stride + outputLayer.size, dst.data() + s * outputLayer.size);
 	}
 	return dst;
 }
 
-void Network::update(double learningRate) {
+template<typename T, typename Acc>
+void Network<T, Acc>::backtrackBatch() {
 
-	for (auto& s : synapses) { s.updateCoeffs(learningRate); }
+	backward(workspace);
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::backtrackBatch(Workspace& ws) {
+
+	backward(ws);
+}
+
+template<typename T, typename Acc>
+bool Network<T, Acc>::fits(const Workspace& ws) const {
+
+	if (ws.layers.size() != workspace.layers.size()) { return false; }
+	for (int l = 0; l < ws.layers.size(); l++) {
+		if (ws.layers[l].size != workspace.layers[l].size) { return false; }
+	}
+	return true;
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::apply(const T* input, T* output, Workspace& ws) const {
+
+	activateBatch(ws, input, 1);
+	const T* value = ws.values(ws.layers.size() - 1);
+	std::copy(value, value + outputSize(), output);
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::applyBatch(const T* inputs, T* outputs, int batchSize, Workspace& ws) const {
+
+	activateBatch(ws, inputs, batchSize);
+	const Layer& outputLayer = ws.layers.back();
+	const T* value = ws.values(ws.layers.size() - 1);
+	for (int s = 0; s < batchSize; s++) {
+		std::copy(value + s * outputLayer.stride, value + s * outputLayer.stride + outputLayer.size, outputs + s * outputLayer.size);
+	}
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::applyBatchFromLayer(int layer, const T* values, T* outputs, int batchSize, Workspace& ws) const {
+
+	allocate(ws, batchSize);
+	const Layer& firstLayer = ws.layers[layer];
+	T* value = ws.values(layer);
+	for (int s = 0; s < batchSize; s++) {
+		std::copy(values + s * firstLayer.size, values + (s + 1) * firstLayer.size, value + s * firstLayer.stride);
+	}
+	forward(ws, layer + 1);
+
+	const Layer& outputLayer = ws.layers.back();
+	const T* output = ws.values(ws.layers.size() - 1);
+	for (int s = 0; s < batchSize; s++) {
+		std::copy(output + s * outputLayer.stride, output + s * outputLayer.stride + outputLayer.size, outputs + s * outputLayer.size);
+	}
 }
 
-void Network::backtrack() {
+template<typename T, typename Acc>
+void Network<T, Acc>::apply(const T* input, T* output) const {
+
+	thread_local Workspace ws; // (created again when the thread uses a network of another topology)
+	if (!fits(ws)) { ws = createWorkspace(); }
+	apply(input, output, ws);
+}
 
-	for (int l = layers.size() - 2; l >= 0; l--) {
-		vector<Neuron>& layer = layers[l];; // local input layer
+template<typename T, typename Acc>
+void Network<T, Acc>::backtrackAndUpdate(Workspace& ws, double learningRate) {
+
+	for (int l = ws.layers.size() - 2; l >= 0; l--) {
+		const Layer& layer = ws.layers[l]; // local input layer
 		Synapses& synapse = synapses[l];
-		vector<Neuron>& nextLayer = layers[l + 1]; // local output layer
-		for (int j = 0; j < layer.size(); j++) {
-			double diffSum = 0;
-			for (int i = 0; i < nextLayer.size() - 1; i++) {
-				diffSum += synapse.get(j, i) * nextLayer[i].diff;
-				double diff = layer[j].value * nextLayer[i].diff;
-				synapse.addDiff(j, i, diff);
+		const Layer& nextLayer = ws.layers[l + 1]; // local output layer
+		const T* nextDiff = ws.diffs(l + 1);
+		const T* value = ws.values(l);
+
+		// diffs of the local input layer, computed with the coefficients before the update
+		if (l > 0) {
+			T* diff = ws.diffs(l);
+			std::fill(diff, diff + layer.size, T(0));
+			for (int i = 0; i < nextLayer.size; i++) {
+				if (nextDiff[i] != 0) { Kernels::axpy(nextDiff[i], synapse.row(i), diff, layer.size); }
 			}
-			layer[j].diff = sigmoidDeriv(layer[j].input) * diffSum;
+			multiplyDerivative(synapses[l - 1].activation, value, diff, layer.size);
+		}
+
+		// sparse update : only the non-zero values have a gradient
+		// (through the shared kernels : concurrent updates may overwrite each other, but never corrupt a coefficient)
+		ws.nonZeros.clear();
+		for (int j = 0; j < layer.size; j++) {
+			if (value[j] != 0) { ws.nonZeros.push_back(j); }
+		}
+		for (int i = 0; i < nextLayer.size; i++) {
+			T step = T(learningRate * nextDiff[i]);
+			if (step == 0) { continue; }
+			T* coeffs = synapse.coefficients.data() + i * synapse.stride;
+			Kernels::sharedAxpy(step, value, ws.nonZeros.data(), ws.nonZeros.size(), coeffs);
+			Kernels::sharedAdd(step, &synapse.bias[i]);
+		}
+	}
+}
+
+// model file format
+
+static const uint32_t modelMagic = 0x54454E4E; // "NNET" in the file
+static const uint32_t modelVersion = 1;
+static const size_t modelAlignment = 64; // of the weight blocks (independent of Kernels::alignment)
+
+static size_t alignedOffset(size_t offset) { return (offset + modelAlignment - 1) / modelAlignment * modelAlignment; }
+
+// nb of scalars in a padded row of inputSize coefficients
+static size_t modelStride(size_t inputSize, size_t scalarSize) {
+
+	size_t width = modelAlignment / scalarSize;
+	return (inputSize + width - 1) / width * width;
+}
+
+static bool isLittleEndian() {
+
+	uint32_t one = 1;
+	return *(unsigned char*)&one == 1;
+}
+
+static void writeUint32(std::ofstream& dst, uint32_t value) {
+
+	unsigned char bytes[4] = { (unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24) };
+	dst.write((const char*)bytes, 4);
+}
+
+static uint32_t readUint32(const unsigned char* src) {
+
+	return uint32_t(src[0]) | (uint32_t(src[1]) << 8) | (uint32_t(src[2]) << 16) | (uint32_t(src[3]) << 24);
+}
+
+static void writePadding(std::ofstream& dst, size_t& offset) {
+
+	static const char zeros[modelAlignment] = {};
+	size_t padded = alignedOffset(offset);
+	dst.write(zeros, padded - offset);
+	offset = padded;
+}
+
+template<typename T, typename Acc>
+void Network<T, Acc>::exportToFile(const std::string& fileName) const {
+
+	if (!isLittleEndian()) { throw std::runtime_error("the model format is little-endian"); }
+	std::ofstream dst(fileName, std::ios::out | std::ios::binary);
+	if (!dst.is_open()) { throw std::runtime_error("can't write " + fileName); }
+
+	// header
+	writeUint32(dst, modelMagic);
+	writeUint32(dst, modelVersion);
+	writeUint32(dst, sizeof(T)); // scalar type : 4 for floats, 8 for doubles
+	writeUint32(dst, workspace.layers.size());
+	for (const Layer& layer : workspace.layers) { writeUint32(dst, layer.size); }
+	for (const Synapses& s : synapses) { writeUint32(dst, s.activation); }
+	size_t offset = 4 * (4 + workspace.layers.size() + synapses.size());
+	writePadding(dst, offset);
+
+	// weight blocks (the rows of coefficients are already padded like in the file)
+	for (const Synapses& s : synapses) {
+		size_t size = s.coefficients.size() * sizeof(T);
+		dst.write((const char*)s.coefficients.data(), size);
+		offset += size;
+		writePadding(dst, offset);
+		size = s.bias.size() * sizeof(T);
+		dst.write((const char*)s.bias.data(), size);
+		offset += size;
+		writePadding(dst, offset);
+	}
+	if (!dst.good()) { throw std::runtime_error("can't write " + fileName); }
+}
+
+// values of another scalar type, copied and converted
+template<typename T, typename Src>
+static MappedArray<T> convertedBlock(const unsigned char* src, int rows, int cols, size_t srcStride, size_t dstStride) {
+
+	MappedArray<T> dst(rows * dstStride, 0);
+	for (int r = 0; r < rows; r++) {
+		for (int c = 0; c < cols; c++) {
+			Src value;
+			std::memcpy(&value, src + (r * srcStride + c) * sizeof(Src), sizeof(Src));
+			dst[r * dstStride + c] = T(value);
 		}
 	}
-}
\ No newline at end of file
+	return dst;
+}
+
+template<typename T>
+static MappedArray<T> loadBlock(const std::shared_ptr<MappedFile>& file, size_t offset, size_t scalarSize, int rows, int cols, size_t dstStride) {
+
+	size_t srcStride = modelStride(cols, scalarSize);
+	if (rows == 1) { srcStride = dstStride = cols; } // (bias : a single unpadded row)
+	if (scalarSize == sizeof(T) && srcStride == dstStride) { return MappedArray<T>(file, offset, rows * dstStride); }
+	if (scalarSize == sizeof(float)) { return convertedBlock<T, float>(file->data() + offset, rows, cols, srcStride, dstStride); }
+	return convertedBlock<T, double>(file->data() + offset, rows, cols, srcStride, dstStride);
+}
+
+template<typename T, typename Acc>
+Network<T, Acc> Network<T, Acc>::importFromFile(const std::string& fileName) {
+
+	if (!isLittleEndian()) { throw std::runtime_error("the model format is little-endian"); }
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(fileName);
+	const unsigned char* src = file->data();
+	size_t fileSize = file->size();
+
+	// header
+	if (fileSize < 16 || readUint32(src) != modelMagic) { throw std::runtime_error(fileName + " is not a model file"); }
+	if (readUint32(src + 4) != modelVersion) { throw std::runtime_error(fileName + " has an unsupported version"); }
+	size_t scalarSize = readUint32(src + 8);
+	size_t nbLayers = readUint32(src + 12);
+	if (scalarSize != sizeof(float) && scalarSize != sizeof(double)) { throw std::runtime_error(fileName + " has an unknown scalar type"); }
+	size_t offset = 4 * (4 + 2 * nbLayers - 1);
+	if (nbLayers < 2 || offset > fileSize) { throw std::runtime_error(fileName + " has an invalid topology"); }
+	vector<int> layerSizes;
+	for (size_t l = 0; l < nbLayers; l++) {
+		int size = int(readUint32(src + 16 + 4 * l));
+		if (size <= 0) { throw std::runtime_error(fileName + " has an invalid topology"); }
+		layerSizes.push_back(size);
+	}
+	vector<Activation> activations;
+	for (size_t l = 0; l + 1 < nbLayers; l++) {
+		uint32_t activation = readUint32(src + 16 + 4 * (nbLayers + l));
+		if (activation > FastSigmoid) { throw std::runtime_error(fileName + " has an unknown activation"); }
+		activations.push_back(Activation(activation));
+	}
+	offset = alignedOffset(offset);
+
+	// weight blocks
+	Network net;
+	for (size_t l = 0; l + 1 < nbLayers; l++) {
+		int input = layerSizes[l], output = layerSizes[l + 1];
+		size_t coeffsOffset = offset;
+		size_t biasOffset = alignedOffset(coeffsOffset + output * modelStride(input, scalarSize) * scalarSize);
+		if (biasOffset + output * scalarSize > fileSize) { throw std::runtime_error(fileName + " is truncated"); }
+		offset = alignedOffset(biasOffset + output * scalarSize);
+
+		size_t stride = Kernels::paddedSize(input, sizeof(T));
+		net.synapses.push_back(Synapses(input, output, activations[l],
+			loadBlock<T>(file, coeffsOffset, scalarSize, output, input, stride),
+			loadBlock<T>(file, biasOffset, scalarSize, 1, output, output)
+		));
+	}
+	net.createLayers(layerSizes);
+	return net;
+}
+
+template class Network<double>;
+template class Network<float>;
+template class Network<float, double>;
\ No newline at end of file
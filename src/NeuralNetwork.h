@@ -2,57 +2,139 @@
 
 #include <vector>
 #include <string>
+#include <cmath>
+
+#include "Activation.h"
+#include "Kernels.h"
+#include "MappedFile.h"
 
 using namespace std;
 
+// T is the type of the weights and neurons, Acc the type of the sums and gradients
+// (Network<float, double> keeps float storage with double precision accumulations)
+template<typename T = double, typename Acc = T>
 class Network
 {
-	inline double sigmoid(double x) { return 1 / (1 + exp(-x)); }
-	inline double sigmoidDeriv(double x) { return sigmoid(x) * (1 - sigmoid(x)); } // TODO : optimize
-	//inline double sigmoid(double x) { return x < 0 ? 0.1*x : x; }
-	//inline double sigmoidDeriv(double x) { return x < 0 ? 0.1 : 1; } // TODO : optimize
-
-	struct Neuron
-	{
-		double input; // sum of all incoming synapses
-		double value; // = activation( input )
-		double diff; // difference between the desired value and the value
-	};
-
 	// connections between several neural layers
 	struct Synapses
 	{
 		int inputLayer; // nb of neurons in the input layer
 		int outputLayer; // nb of neurons in the output layer
+		int stride; // size of a row of coefficients : inputLayer, padded to the SIMD width (with zeros)
+		Activation activation; // of the output layer
 	//private: TODO
-		vector<double> coefficients; // coefficients of each connection
-		vector<double> gradient; // delta to add to the coefficient for the next step
+		MappedArray<T> coefficients; // coefficients of each connection, one row per output neuron (may be in a model file)
+		MappedArray<T> bias; // added to the input of each output neuron
+		AlignedVector<Acc> gradient; // delta to add to the coefficient for the next step (allocated on the first backtrack)
+		AlignedVector<Acc> biasGradient; // delta to add to the bias for the next step
 
 	public:
-		inline double get(int input, int output) const { return coefficients[output * inputLayer + input]; } // get coefficient
-		inline void set(int input, int output, double value) { coefficients[output * inputLayer + input] = value; } // set coefficient
-		void addDiff(int input, int output, double value) { gradient[output * inputLayer + input] += value; }
+		inline T get(int input, int output) const { return coefficients[output * stride + input]; } // get coefficient
+		inline void set(int input, int output, T value) { coefficients[output * stride + input] = value; } // set coefficient
+		void addDiff(int input, int output, Acc value) { allocateGradients(); gradient[output * stride + input] += value; }
+		inline const T* row(int output) const { return coefficients.data() + output * stride; } // coefficients of an output neuron
 
-		Synapses(int input, int output, double initCoeff);
+		Synapses(int input, int output, double initCoeff, Activation activation = Sigmoid);
+		Synapses(int input, int output, Activation activation, MappedArray<T> coefficients, MappedArray<T> bias);
 
-		void updateCoeffs(double learningRate) { for (int i = 0; i < coefficients.size(); i++) { coefficients[i] += learningRate * gradient[i]; gradient[i] = 0; } }
+		void allocateGradients();
+		void updateCoeffs(double learningRate);
+	};
+
+	// neurons of a layer, for batchSize samples : each array is a batchSize x stride row-major matrix
+	// (offsets in the storage of a workspace, so that workspaces can be copied)
+	struct Layer
+	{
+		int size; // nb of neurons
+		int stride; // size of a row : size, padded to the SIMD width
+		size_t input; // sum of all incoming synapses
+		size_t value; // = activation( input ), the derivatives are computed from it
+		size_t diff; // difference between the desired value and the value
 	};
 
 public:
 
-	vector<vector<Neuron>> layers;
+	typedef T Scalar;
+	typedef Acc Accumulator;
+
+	// neurons of all layers for a batch of samples, in a single allocation, and the gradient they produce
+	// (each thread needs its own workspace to use the same network)
+	struct Workspace
+	{
+		int batchSize; // nb of samples currently in the layers
+		int capacity; // max nb of samples that the storage can hold
+		vector<Layer> layers;
+		AlignedVector<T> storage; // the neurons of all layers
+		vector<AlignedVector<Acc>> gradients, biasGradients; // shadows of the synapses gradients (if empty, the synapses gradients are used)
+		vector<int> nonZeros; // indices of the non-zero neurons of a layer (for sparse updates)
+
+		inline T* inputs(int l) { return storage.data() + layers[l].input; }
+		inline T* values(int l) { return storage.data() + layers[l].value; }
+		inline T* diffs(int l) { return storage.data() + layers[l].diff; }
+		void addGradients(const Workspace& src); // adds the gradients of another workspace to this one
+		void clearGradients();
+	};
+
+private:
+
+	Workspace workspace; // used by the single-thread interface
+
+	Network() {}
+	void createLayers(const vector<int>& layerSizes);
+	bool fits(const Workspace& ws) const; // true if the workspace has the topology of the network
+
+	void forward(Workspace& ws, int firstLayer = 1) const; // activates the layers from firstLayer, for the batchSize samples
+	void backward(Workspace& ws); // backtracks the diffs of the output layer, and accumulates the gradient
+
+public:
+
 	vector<Synapses> synapses;
 
 	Network(
 		vector<int> layers, // sizes of each layers
-		double initCoeffs = 0.1 // magnitude of random initial coeffs (uniforms in [-1;1])
+		double initCoeffs = 0.1, // magnitude of random initial coeffs (uniforms in [-1;1])
+		vector<Activation> activations = {} // of each layer but the input (empty : sigmoids everywhere)
 	);
-	void setInput(const double* values);
+	int inputSize() const { return workspace.layers.front().size; }
+	int outputSize() const { return workspace.layers.back().size; }
+
+	void setInput(const T* values);
 	void activate();
-	void setDesiredOutput(const double* values);
-	vector<double> getOuput();
+	void setDesiredOutput(const T* values);
+	vector<T> getOuput();
 	void update(double learningRate);
 	void backtrack();
-	void exportToFile(const std::string& fileName) const; // TODO
-	static Network importFromFile(const std::string& fileName); // TODO
+
+	// same as above, on batchSize samples at once (inputs and outputs are row-major batchSize x layerSize matrices)
+	void activateBatch(const T* inputs, int batchSize);
+	void setDesiredOutputBatch(const T* values);
+	vector<T> getOutputBatch();
+	void backtrackBatch(); // accumulates the gradient of the whole batch
+
+	// same as above, in a workspace of the caller
+	Workspace createWorkspace(bool ownGradients = false) const; // ownGradients : gradients are accumulated in the workspace
+	void allocate(Workspace& ws, int batchSize) const; // resizes the layers to hold batchSize samples
+	void activateBatch(Workspace& ws, const T* inputs, int batchSize) const;
+	void setDesiredOutputBatch(Workspace& ws, const T* values) const;
+	void backtrackBatch(Workspace& ws);
+	void addGradients(const Workspace& ws); // adds the gradients of a workspace to the synapses
+
+	// inference of a single sample (inputSize values to outputSize values), nothing is allocated
+	// once the workspace holds a sample ; several threads can share the network, each with its workspace
+	void apply(const T* input, T* output, Workspace& ws) const;
+	void apply(const T* input, T* output) const; // in a workspace local to the calling thread
+	void applyBatch(const T* inputs, T* outputs, int batchSize, Workspace& ws) const; // (row-major matrices)
+	// inference from the values of a hidden layer (batchSize x its size), computed elsewhere (eg: by a convolution)
+	void applyBatchFromLayer(int layer, const T* values, T* outputs, int batchSize, Workspace& ws) const;
+
+	// backtracks the single sample of a workspace, and adds its gradient to the coefficients right away
+	// (for asynchronous training : several threads may call it at once, their updates race without locks)
+	void backtrackAndUpdate(Workspace& ws, double learningRate);
+
+	// binary model file : little-endian header (magic, version, scalar type, topology, activations), then the
+	// coefficients and the bias of each synapses, in blocks aligned on 64 bytes (rows padded like in memory)
+	// importing maps the file : the weights are read from the shared pages, until they are trained (copy-on-write)
+	// both throw std::runtime_error on failure ; a file of another scalar type is converted (and copied)
+	void exportToFile(const std::string& fileName) const;
+	static Network importFromFile(const std::string& fileName);
 };
\ No newline at end of file
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// queue between two threads, whose push waits while it is full
+template<typename T>
+class BoundedQueue
+{
+	std::deque<T> items;
+	size_t capacity;
+	bool closed;
+	std::mutex mutex;
+	std::condition_variable notFull, notEmpty;
+
+public:
+	BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+	void push(T item) {
+
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [&] { return items.size() < capacity; });
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+	}
+
+	// waits for an item ; false once the queue is closed and empty
+	bool pop(T& item) {
+
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [&] { return closed || !items.empty(); });
+		if (items.empty()) { return false; }
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	void close() { // (no more pushes)
+
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		notEmpty.notify_all();
+	}
+};
+
+// items read by a source, transformed by stages that each have their own workers, then given to a sink
+// in the order of the source (whatever the order they were processed in) ; at most capacity items are in the pipeline
+// the source and the sink are called from a single thread each, the stages from all their workers at once
+template<typename Item>
+class Pipeline
+{
+public:
+	typedef std::function<bool(Item&)> Stage; // false drops the item (it won't reach the next stages)
+
+private:
+	struct Entry {
+		long long index; // in the order of the source
+		bool dropped;
+		Item item;
+	};
+	std::vector<std::pair<Stage, int>> stages; // with their nb of workers
+	int capacity;
+
+public:
+	Pipeline(int capacity = 64) : capacity(capacity) {}
+
+	void addStage(Stage stage, int workers = ThreadPool::defaultThreads()) { stages.push_back({ stage, std::max(workers, 1) }); }
+
+	// source fills the next item, and returns false when there are none left ; sink is called on the calling thread
+	// an exception thrown by the source or a stage stops the pipeline, and is thrown again once its threads are joined
+	void run(std::function<bool(Item&)> source, std::function<void(Item&)> sink) {
+
+		std::vector<std::unique_ptr<BoundedQueue<Entry>>> queues;
+		for (int s = 0; s <= stages.size(); s++) { queues.emplace_back(new BoundedQueue<Entry>(capacity)); }
+
+		std::mutex mutex;
+		std::condition_variable delivered;
+		long long nbDelivered = 0; // the source waits for the sink, so that the reordering is bounded too
+		bool stopping = false;
+		std::exception_ptr error;
+		auto fail = [&](std::exception_ptr e) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error) { error = e; }
+			stopping = true;
+			delivered.notify_all();
+		};
+
+		std::vector<std::thread> threads;
+		threads.push_back(std::thread([&] {
+			try {
+				for (long long index = 0; true; index++) {
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						delivered.wait(lock, [&] { return stopping || index - nbDelivered < capacity; });
+						if (stopping) { break; }
+					}
+					Entry entry{ index, false, Item() };
+					if (!source(entry.item)) { break; }
+					queues[0]->push(std::move(entry));
+				}
+			}
+			catch (...) { fail(std::current_exception()); }
+			queues[0]->close();
+		}));
+
+		// workers of each stage, the last one to finish closes the next queue
+		std::vector<std::unique_ptr<std::atomic<int>>> running;
+		for (int s = 0; s < stages.size(); s++) { running.emplace_back(new std::atomic<int>(stages[s].second)); }
+		for (int s = 0; s < stages.size(); s++) {
+			for (int w = 0; w < stages[s].second; w++) {
+				threads.push_back(std::thread([&, s] {
+					Entry entry;
+					while (queues[s]->pop(entry)) {
+						if (!entry.dropped) {
+							try { entry.dropped = !stages[s].first(entry.item); }
+							catch (...) { fail(std::current_exception()); entry.dropped = true; }
+						}
+						queues[s + 1]->push(std::move(entry)); // (dropped items keep their place in the order)
+					}
+					if (--*running[s] == 0) { queues[s + 1]->close(); }
+				}));
+			}
+		}
+
+		// ordered sink
+		std::map<long long, Entry> pending; // items processed before the previous ones
+		Entry entry;
+		while (queues.back()->pop(entry)) {
+			pending.emplace(entry.index, std::move(entry));
+			while (!pending.empty() && pending.begin()->first == nbDelivered) {
+				Entry& next = pending.begin()->second;
+				bool stopped;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopped = stopping;
+				}
+				if (!next.dropped && !stopped) {
+					try { sink(next.item); }
+					catch (...) { fail(std::current_exception()); }
+				}
+				pending.erase(pending.begin());
+				std::lock_guard<std::mutex> lock(mutex);
+				nbDelivered++;
+				delivered.notify_all();
+			}
+		}
+
+		for (std::thread& t : threads) { t.join(); }
+		if (error) { std::rethrow_exception(error); }
+	}
+};
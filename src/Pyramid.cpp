@@ -0,0 +1,268 @@
+#include "Pyramid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+template<typename T, typename Acc>
+PyramidDetector<T, Acc>::PyramidDetector(const Network<T, Acc>& net, int windowWidth, int windowHeight, Score score, double scaleFactor, int threads) :
+	ownCascade(new Cascade<T, Acc>(windowWidth, windowHeight)), cascade(*ownCascade),
+	windowWidth(windowWidth), windowHeight(windowHeight), scaleFactor(scaleFactor),
+	pool(threads > 0 ? threads : ThreadPool::defaultThreads()) {
+
+	ownCascade->addNetworkStage("network", net, score);
+}
+
+template<typename T, typename Acc>
+PyramidDetector<T, Acc>::PyramidDetector(const Cascade<T, Acc>& cascade, double scaleFactor, int threads) :
+	cascade(cascade), windowWidth(cascade.width()), windowHeight(cascade.height()), scaleFactor(scaleFactor),
+	pool(threads > 0 ? threads : ThreadPool::defaultThreads()) {}
+
+// van Herk / Gil-Werman : the extremum (the min or the max, by better) of each window of k consecutive values among n
+// (step apart), with 3 comparisons per value whatever k ; n - k + 1 extremums (outStep apart)
+template<typename T, typename Better>
+static void slidingExtremum(const T* values, int n, int step, int k, T* out, int outStep, Better better,
+	std::vector<T>& fromStart, std::vector<T>& toEnd) {
+
+	// extremums of the blocks of k values : from their start, and to their end
+	fromStart.resize(n); toEnd.resize(n);
+	for (int i = 0; i < n; i++) {
+		T v = values[i*step];
+		fromStart[i] = (i % k == 0 || better(v, fromStart[i - 1])) ? v : fromStart[i - 1];
+	}
+	for (int i = n - 1; i >= 0; i--) {
+		T v = values[i*step];
+		toEnd[i] = (i % k == k - 1 || i == n - 1 || better(v, toEnd[i + 1])) ? v : toEnd[i + 1];
+	}
+
+	// a window is the end of a block and the start of the next one
+	for (int i = 0; i + k <= n; i++) {
+		T a = toEnd[i], b = fromStart[i + k - 1];
+		out[i*outStep] = better(b, a) ? b : a;
+	}
+}
+
+// bands of rows of the windows, taken by the threads (across all scales)
+static const int bandHeight = 16;
+
+template<typename T, typename Acc>
+void PyramidDetector<T, Acc>::resizeScales(const cv::Mat& image, std::vector<Scale>& scales) const {
+
+	int w = windowWidth, h = windowHeight;
+	cv::Mat src;
+	image.convertTo(src, cv::DataType<T>::type, 1.0 / 255);
+	int s = 0;
+	for (double factor = 1; int(src.size().width * factor) >= w && int(src.size().height * factor) >= h; factor *= scaleFactor, s++) {
+		cv::Size size(int(src.size().width * factor), int(src.size().height * factor));
+		if (s == scales.size() || scales[s].im.size().width != size.width || scales[s].im.size().height != size.height) {
+			scales.resize(s);
+			scales.push_back(Scale());
+			scales[s].factor = factor;
+			scales[s].outWidth = size.width - w + 1;
+			scales[s].outHeight = size.height - h + 1;
+			scales[s].confidence.resize(size_t(scales[s].outWidth) * scales[s].outHeight);
+		}
+		cv::resize(src, scales[s].im, size, 0, 0, cv::INTER_AREA);
+		if (scaleFactor >= 1) { s++; break; }
+	}
+	scales.resize(s);
+}
+
+template<typename T, typename Acc>
+long long PyramidDetector<T, Acc>::scoreScales(std::vector<Scale>& scales) {
+
+	int w = windowWidth, h = windowHeight;
+	std::vector<std::pair<int, int>> bands; // scale and first row, of the bands with positions to score
+	for (int s = 0; s < scales.size(); s++) {
+		const Scale& scale = scales[s];
+		for (int y0 = 0; y0 < scale.outHeight; y0 += bandHeight) {
+			size_t first = size_t(y0) * scale.outWidth, last = size_t(std::min(y0 + bandHeight, scale.outHeight)) * scale.outWidth;
+			if (scale.dirty.empty() || std::find(scale.dirty.begin() + first, scale.dirty.begin() + last, 1) != scale.dirty.begin() + last) {
+				bands.push_back({ s, y0 });
+			}
+		}
+	}
+	if (bands.empty()) { return 0; }
+
+	// confidence at each position : a row of windows at once
+	std::atomic<int> nextBand(0);
+	std::atomic<long long> nbScored(0);
+	pool.run(std::min<int>(pool.size(), bands.size()), [&](int) {
+		std::vector<T> rowMin, rowMax, windowMin, windowMax, fromStart, toEnd, ranges, windows;
+		std::vector<int> columns, kept; // of the positions of a row to score, and of those the range stages keep
+		std::vector<double> confidences;
+		typename Cascade<T, Acc>::Workspace ws = cascade.createWorkspace();
+		for (int b = nextBand++; b < bands.size(); b = nextBand++) {
+			Scale& scale = scales[bands[b].first];
+			int y0 = bands[b].second, y1 = std::min(y0 + bandHeight, scale.outHeight);
+			int outWidth = scale.outWidth, rows = y1 - y0 + h - 1, wI = scale.im.size().width;
+			const T* pixels = (const T*)scale.im.data;
+
+			// min and max of the windows : over w pixels of each row, then over h of these rows
+			rowMin.resize(size_t(rows) * outWidth); rowMax.resize(rowMin.size());
+			for (int r = 0; r < rows; r++) {
+				const T* row = pixels + size_t(y0 + r) * wI;
+				slidingExtremum(row, wI, 1, w, rowMin.data() + size_t(r) * outWidth, 1, std::less<T>(), fromStart, toEnd);
+				slidingExtremum(row, wI, 1, w, rowMax.data() + size_t(r) * outWidth, 1, std::greater<T>(), fromStart, toEnd);
+			}
+			windowMin.resize(size_t(y1 - y0) * outWidth); windowMax.resize(windowMin.size());
+			for (int x = 0; x < outWidth; x++) {
+				slidingExtremum(rowMin.data() + x, rows, outWidth, h, windowMin.data() + x, outWidth, std::less<T>(), fromStart, toEnd);
+				slidingExtremum(rowMax.data() + x, rows, outWidth, h, windowMax.data() + x, outWidth, std::greater<T>(), fromStart, toEnd);
+			}
+
+			// the windows of each row, classified at once : the range stages of the cascade on their min and max, then the
+			// next stages on those they keep, normalized
+			windows.resize(size_t(outWidth) * w*h);
+			for (int y = y0; y < y1; y++) {
+				columns.clear();
+				ranges.clear();
+				for (int x = 0; x < outWidth; x++) {
+					if (!scale.dirty.empty() && !scale.dirty[size_t(y) * outWidth + x]) { continue; }
+					columns.push_back(x);
+					ranges.push_back(windowMax[size_t(y - y0) * outWidth + x] - windowMin[size_t(y - y0) * outWidth + x]);
+				}
+				kept.resize(columns.size());
+				int nbKept = cascade.applyRanges(ranges.data(), columns.size(), kept.data());
+				for (int i = 0; i < nbKept; i++) {
+					int x = columns[kept[i]];
+					T lowest = windowMin[size_t(y - y0) * outWidth + x], range = ranges[kept[i]];
+					T scaling = range > 0 ? 1 / range : 0; // (a flat window is 0)
+					T* window = windows.data() + size_t(i) * w*h;
+					for (int y2 = 0; y2 < h; y2++) {
+						const T* row = pixels + size_t(y + y2) * wI + x;
+						for (int x2 = 0; x2 < w; x2++) { window[y2*w + x2] = (row[x2] - lowest) * scaling; }
+					}
+				}
+				confidences.resize(nbKept);
+				cascade.apply(windows.data(), nbKept, confidences.data(), ws);
+				for (int x : columns) { scale.confidence[size_t(y) * outWidth + x] = -std::numeric_limits<double>::infinity(); }
+				for (int i = 0; i < nbKept; i++) { scale.confidence[size_t(y) * outWidth + columns[kept[i]]] = confidences[i]; }
+				nbScored += columns.size();
+			}
+		}
+	});
+	return nbScored;
+}
+
+template<typename T, typename Acc>
+std::vector<Detection> PyramidDetector<T, Acc>::collect(const std::vector<Scale>& scales, double threshold, int maxDetections,
+	double maxOverlap, std::vector<cv::Mat>* maps) const {
+
+	// local maximums of each scale (among equal neighbors, the first one), merged
+	int w = windowWidth, h = windowHeight;
+	std::vector<Detection> candidates;
+	for (const Scale& scale : scales) {
+		int outWidth = scale.outWidth, outHeight = scale.outHeight;
+		for (int y = 0; y < outHeight; y++) {
+			for (int x = 0; x < outWidth; x++) {
+				int index = y*outWidth + x;
+				double confidence = scale.confidence[index];
+				if (confidence <= threshold) { continue; }
+				bool isMaximum = true;
+				for (int y2 = std::max(y - 1, 0); y2 <= std::min(y + 1, outHeight - 1) && isMaximum; y2++) {
+					for (int x2 = std::max(x - 1, 0); x2 <= std::min(x + 1, outWidth - 1); x2++) {
+						int neighbor = y2*outWidth + x2;
+						double c = scale.confidence[neighbor];
+						if (c > confidence || (c == confidence && neighbor < index)) { isMaximum = false; break; }
+					}
+				}
+				if (isMaximum) {
+					candidates.push_back({ int(x / scale.factor), int(y / scale.factor), int(w / scale.factor), int(h / scale.factor), 0, confidence });
+				}
+			}
+		}
+	}
+
+	if (maps != NULL) {
+		maps->clear();
+		for (const Scale& scale : scales) {
+			cv::Mat map(cv::Size(scale.outWidth, scale.outHeight), CV_64FC1);
+			std::copy(scale.confidence.begin(), scale.confidence.end(), (double*)map.data);
+			maps->push_back(map);
+		}
+	}
+	return nonMaximumSuppression(candidates, maxDetections, maxOverlap);
+}
+
+template<typename T, typename Acc>
+std::vector<Detection> PyramidDetector<T, Acc>::detect(const cv::Mat& image, double threshold, int maxDetections, double maxOverlap,
+	std::vector<cv::Mat>* maps) {
+
+	std::vector<Scale> scales;
+	resizeScales(image, scales);
+	scoreScales(scales);
+	return collect(scales, threshold, maxDetections, maxOverlap, maps);
+}
+
+template<typename T, typename Acc>
+StreamingDetector<T, Acc>::StreamingDetector(PyramidDetector<T, Acc>& detector, int tileSize, int tolerance, int refreshPeriod) :
+	detector(detector), tileSize(std::max(tileSize, 1)), tolerance(tolerance), refreshPeriod(refreshPeriod), nbFrames(0), updated(0) {}
+
+template<typename T, typename Acc>
+std::vector<Detection> StreamingDetector<T, Acc>::detect(const cv::Mat& frame, double threshold, int maxDetections, double maxOverlap,
+	std::vector<cv::Mat>* maps) {
+
+	int W = frame.size().width, H = frame.size().height;
+	bool refresh = scales.empty() || reference.size().width != W || reference.size().height != H
+		|| (refreshPeriod > 0 && nbFrames % refreshPeriod == 0);
+	nbFrames++;
+	detector.resizeScales(frame, scales);
+
+	if (refresh) {
+		frame.copyTo(reference);
+		for (auto& scale : scales) { scale.dirty.clear(); }
+	}
+	else {
+		// the tiles that changed since they were last scored (the reference keeps their pixels of then)
+		struct Tile { int x0, y0, x1, y1; };
+		std::vector<Tile> changed;
+		for (int ty = 0; ty < H; ty += tileSize) {
+			for (int tx = 0; tx < W; tx += tileSize) {
+				Tile tile = { tx, ty, std::min(tx + tileSize, W), std::min(ty + tileSize, H) };
+				bool isChanged = false;
+				for (int y = tile.y0; y < tile.y1 && !isChanged; y++) {
+					const uchar* src = frame.data + size_t(y) * W, *ref = reference.data + size_t(y) * W;
+					for (int x = tile.x0; x < tile.x1; x++) {
+						if (std::abs(int(src[x]) - int(ref[x])) > tolerance) { isChanged = true; break; }
+					}
+				}
+				if (!isChanged) { continue; }
+				for (int y = tile.y0; y < tile.y1; y++) {
+					std::copy(frame.data + size_t(y) * W + tile.x0, frame.data + size_t(y) * W + tile.x1, reference.data + size_t(y) * W + tile.x0);
+				}
+				changed.push_back(tile);
+			}
+		}
+
+		// the windows overlapping them, at each scale (with a pixel more around the tile, for the interpolation)
+		int w = detector.windowWidth, h = detector.windowHeight;
+		for (auto& scale : scales) {
+			scale.dirty.assign(size_t(scale.outWidth) * scale.outHeight, 0);
+			double fx = double(scale.im.size().width) / W, fy = double(scale.im.size().height) / H;
+			for (const Tile& tile : changed) {
+				int x0 = std::max(int(tile.x0 * fx) - 1 - w + 1, 0), x1 = std::min(int(std::ceil(tile.x1 * fx)) + 1, scale.outWidth - 1);
+				int y0 = std::max(int(tile.y0 * fy) - 1 - h + 1, 0), y1 = std::min(int(std::ceil(tile.y1 * fy)) + 1, scale.outHeight - 1);
+				for (int y = y0; y <= y1; y++) {
+					std::fill(scale.dirty.begin() + size_t(y) * scale.outWidth + x0, scale.dirty.begin() + size_t(y) * scale.outWidth + x1 + 1, 1);
+				}
+			}
+		}
+	}
+
+	long long nbWindows = 0;
+	for (const auto& scale : scales) { nbWindows += (long long)scale.outWidth * scale.outHeight; }
+	long long nbScored = detector.scoreScales(scales);
+	updated = nbWindows > 0 ? double(nbScored) / nbWindows : 0;
+
+	return detector.collect(scales, threshold, maxDetections, maxOverlap, maps);
+}
+
+template class PyramidDetector<double, double>;
+template class PyramidDetector<float, float>;
+template class PyramidDetector<float, double>;
+template class StreamingDetector<double, double>;
+template class StreamingDetector<float, float>;
+template class StreamingDetector<float, double>;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Cascade.h"
+#include "Detection.h"
+#include "ThreadPool.h"
+
+#include <memory>
+
+#include <opencv2\opencv.hpp>
+
+// detects windows at all the scales of an image (a pyramid of scales scaleFactor apart) : each window is normalized to
+// [0;1] by its min and max, then given to a network, or to a cascade of them (whose range stages reject windows before). Scales, and bands of rows of each scale, are
+// processed concurrently, and the min and max of all windows are computed by sliding them over the rows then the columns
+// (van Herk / Gil-Werman) ; the network or the cascade is referenced, not copied
+template<typename T, typename Acc> class StreamingDetector;
+
+template<typename T, typename Acc = T>
+class PyramidDetector {
+public:
+	// confidence of a window (its normalized values) from the outputs of the network : the higher, the better
+	typedef typename Cascade<T, Acc>::Score Score;
+private:
+	friend class StreamingDetector<T, Acc>;
+	struct Scale {
+		double factor;
+		cv::Mat im;
+		int outWidth, outHeight; // nb of positions of the windows
+		std::vector<double> confidence; // at each position
+		std::vector<char> dirty; // the positions to score (all of them if empty)
+	};
+	std::unique_ptr<Cascade<T, Acc>> ownCascade; // (of a single network)
+	const Cascade<T, Acc>& cascade;
+	int windowWidth, windowHeight;
+	double scaleFactor;
+	ThreadPool pool; // bands of rows of all the scales are shared among its threads
+
+	// the images of the scales, whose confidences are kept if the image has the same dimensions as before
+	void resizeScales(const cv::Mat& image, std::vector<Scale>& scales) const;
+	long long scoreScales(std::vector<Scale>& scales); // confidence of the (dirty) positions ; returns their number
+	std::vector<Detection> collect(const std::vector<Scale>& scales, double threshold, int maxDetections, double maxOverlap,
+		std::vector<cv::Mat>* maps) const;
+public:
+	// throws std::invalid_argument if the input layer of the network isn't the size of the window
+	PyramidDetector(const Network<T, Acc>& net, int windowWidth, int windowHeight, Score score, double scaleFactor = 0.8, int threads = 0);
+	PyramidDetector(const Cascade<T, Acc>& cascade, double scaleFactor = 0.8, int threads = 0);
+
+	// local maximums of the confidence above threshold at each scale, merged by non-maximum suppression (in the coordinates
+	// of the image, 8 bits gray) ; maps : the confidence at each position of each scale (CV_64FC1, -infinity where the
+	// cascade rejected the window), if not NULL
+	// (runs on the threads of the detector : calls must not overlap, as for ThreadPool::run)
+	std::vector<Detection> detect(const cv::Mat& image, double threshold, int maxDetections, double maxOverlap = 0,
+		std::vector<cv::Mat>* maps = NULL);
+};
+
+// detection on the frames of a video (8 bits gray, of the same dimensions) : the frame is compared to the previous ones by
+// tiles, and only the windows overlapping the tiles that changed since they were last scored are scored again, the others
+// keep their confidence ; all of them are scored every refreshPeriod frames (0 : never), which bounds the drift
+// tolerance : the largest difference of a pixel (in gray levels) of a tile that didn't change (for the noise of the camera)
+template<typename T, typename Acc = T>
+class StreamingDetector {
+	PyramidDetector<T, Acc>& detector; // (and its threads)
+	int tileSize, tolerance, refreshPeriod;
+	cv::Mat reference; // the pixels of each tile when its windows were last scored
+	std::vector<typename PyramidDetector<T, Acc>::Scale> scales;
+	long long nbFrames;
+	double updated;
+public:
+	StreamingDetector(PyramidDetector<T, Acc>& detector, int tileSize = 16, int tolerance = 8, int refreshPeriod = 100);
+	// as PyramidDetector::detect, for the next frame
+	std::vector<Detection> detect(const cv::Mat& frame, double threshold, int maxDetections, double maxOverlap = 0,
+		std::vector<cv::Mat>* maps = NULL);
+	void reset() { scales.clear(); } // the next frame is scored entirely
+	double lastUpdate() const { return updated; } // fraction of the windows scored for the last frame
+};
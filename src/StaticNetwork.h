@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+// layers of a StaticNetwork : each layer holds its neurons and the synapses to the next layer,
+// the sizes are template parameters so that all loops have constant bounds (and get unrolled)
+namespace StaticLayers {
+
+	template<typename T> inline T sigmoid(T x) { return 1 / (1 + exp(-x)); }
+	template<typename T> inline T sigmoidDerivFromValue(T value) { return value * (1 - value); } // = sigmoid'(x), with value = sigmoid(x)
+
+	template<typename T, int... sizes> struct Stack;
+
+	// output layer
+	template<typename T, int N>
+	struct Stack<T, N>
+	{
+		static const int size = N;
+		static const int outputSize = N;
+		std::array<T, N> value; // = sigmoid( input )
+		std::array<T, N> diff; // difference between the desired value and the value
+
+		void init(double) { value.fill(0); diff.fill(0); }
+		void forward() {}
+		void backward(bool) {}
+		void update(T) {}
+		void infer(const T* value, T* output) const { std::copy(value, value + N, output); }
+		Stack& output() { return *this; }
+		const Stack& output() const { return *this; }
+	};
+
+	// layer of N neurons, connected to a layer of M neurons
+	template<typename T, int N, int M, int... Rest>
+	struct Stack<T, N, M, Rest...>
+	{
+		typedef Stack<T, M, Rest...> Next;
+		static const int size = N;
+		static const int outputSize = Next::outputSize;
+		std::array<T, N> value;
+		std::array<T, N> diff;
+		std::array<T, N * M> coefficients, gradient; // one row per output neuron
+		std::array<T, M> bias, biasGradient;
+		Next next;
+
+		void init(double initCoeffs) { // same draws as Network
+
+			for (int o = 0; o < M; o++) {
+				for (int i = 0; i < N; i++) { coefficients[o*N + i] = T(initCoeffs*(1 - 2 * double(rand()) / RAND_MAX)); }
+				bias[o] = T(-initCoeffs*(1 - 2 * double(rand()) / RAND_MAX));
+			}
+			gradient.fill(0); biasGradient.fill(0);
+			value.fill(0); diff.fill(0);
+			next.init(initCoeffs);
+		}
+
+		void forward() {
+
+			for (int o = 0; o < M; o++) {
+				T sum = bias[o];
+				for (int i = 0; i < N; i++) { sum += coefficients[o*N + i] * value[i]; }
+				next.value[o] = sigmoid(sum);
+			}
+			next.forward();
+		}
+
+		// const forward pass, with the neurons on the stack
+		void infer(const T* value, T* output) const {
+
+			std::array<T, M> nextValue;
+			for (int o = 0; o < M; o++) {
+				T sum = bias[o];
+				for (int i = 0; i < N; i++) { sum += coefficients[o*N + i] * value[i]; }
+				nextValue[o] = sigmoid(sum);
+			}
+			next.infer(nextValue.data(), output);
+		}
+
+		void backward(bool isInput) {
+
+			next.backward(false); // the diffs of the next layer are needed first
+			for (int o = 0; o < M; o++) {
+				for (int i = 0; i < N; i++) { gradient[o*N + i] += next.diff[o] * value[i]; }
+				biasGradient[o] += next.diff[o];
+			}
+			if (isInput) { return; } // the input layer doesn't need its diffs
+			for (int i = 0; i < N; i++) {
+				T sum = 0;
+				for (int o = 0; o < M; o++) { sum += next.diff[o] * coefficients[o*N + i]; }
+				diff[i] = sum * sigmoidDerivFromValue(value[i]);
+			}
+		}
+
+		void update(T learningRate) {
+
+			for (int k = 0; k < N * M; k++) { coefficients[k] += learningRate * gradient[k]; }
+			for (int o = 0; o < M; o++) { bias[o] += learningRate * biasGradient[o]; }
+			gradient.fill(0); biasGradient.fill(0);
+			next.update(learningRate);
+		}
+
+		auto& output() { return next.output(); }
+		const auto& output() const { return next.output(); }
+	};
+}
+
+// neural network whose layer sizes are known at compile time (eg: StaticNetwork<double, 2, 3, 1>), for tiny models
+// neurons and coefficients are in std::arrays, without heap allocations ; same interface as Network
+template<typename T, int... sizes>
+class StaticNetwork
+{
+	typedef StaticLayers::Stack<T, sizes...> Layers;
+	Layers layers;
+
+public:
+
+	typedef T Scalar;
+	typedef T Accumulator;
+
+	StaticNetwork(
+		double initCoeffs = 0.1 // magnitude of random initial coeffs (uniforms in [-1;1])
+	) { layers.init(initCoeffs); }
+	static int inputSize() { return Layers::size; }
+	static int outputSize() { return Layers::outputSize; }
+
+	void setInput(const T* values) { std::copy(values, values + Layers::size, layers.value.begin()); }
+	void activate() { layers.forward(); }
+	void setDesiredOutput(const T* values) {
+
+		auto& output = layers.output();
+		for (int i = 0; i < Layers::outputSize; i++) {
+			output.diff[i] = StaticLayers::sigmoidDerivFromValue(output.value[i]) * (values[i] - output.value[i]); // delta = g'(in) * (y - a)
+		}
+	}
+	std::array<T, Layers::outputSize> getOuput() const { return layers.output().value; }
+	void update(double learningRate) { layers.update(T(learningRate)); }
+	void backtrack() { layers.backward(true); }
+	void apply(const T* input, T* output) const { layers.infer(input, output); } // without side effects, thread-safe
+};
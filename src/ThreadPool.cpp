@@ -0,0 +1,72 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int nbThreads) : task(NULL), nbTasks(0), nextTask(0), nbRunning(0), generation(0), stopping(false) {
+
+	for (int i = 1; i < nbThreads; i++) {
+		workers.push_back(std::thread(&ThreadPool::work, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (std::thread& t : workers) { t.join(); }
+}
+
+int ThreadPool::defaultThreads() {
+
+	int n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+void ThreadPool::runTasks() {
+
+	for (int i = nextTask++; i < nbTasks; i = nextTask++) { (*task)(i); }
+}
+
+void ThreadPool::work() {
+
+	int lastGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeUp.wait(lock, [&] { return stopping || generation != lastGeneration; });
+			if (stopping) { return; }
+			lastGeneration = generation;
+		}
+		runTasks();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			nbRunning--;
+		}
+		finished.notify_all();
+	}
+}
+
+void ThreadPool::run(int nbTasks, const std::function<void(int)>& task) {
+
+	if (nbTasks <= 0) { return; }
+	if (workers.empty() || nbTasks == 1) { // no need to wake up the workers
+		for (int i = 0; i < nbTasks; i++) { task(i); }
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = &task;
+		this->nbTasks = nbTasks;
+		nextTask = 0;
+		nbRunning = workers.size();
+		generation++;
+	}
+	wakeUp.notify_all();
+	runTasks();
+
+	// waiting for the workers to leave this batch, before its task goes out of scope
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&] { return nbRunning == 0; });
+}
\ No newline at end of file
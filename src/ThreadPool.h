@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// persistent worker threads, that run batches of independent tasks
+class ThreadPool
+{
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wakeUp, finished;
+
+	// current batch of tasks
+	const std::function<void(int)>* task;
+	int nbTasks;
+	std::atomic<int> nextTask; // index of the next task to run
+	int nbRunning; // nb of workers still in the current batch
+	int generation; // incremented for every batch, to wake up the workers
+	bool stopping;
+
+	void work(); // loop of the workers
+	void runTasks(); // runs tasks of the current batch until there are none left
+
+public:
+
+	ThreadPool(int nbThreads = defaultThreads()); // nbThreads includes the calling thread
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int size() const { return workers.size() + 1; }
+
+	// runs task(0) ... task(nbTasks-1) on the workers and the calling thread, and waits for all of them
+	// (the order of execution is not defined : each task must only write to its own data)
+	// run must not be called from several threads at once
+	void run(int nbTasks, const std::function<void(int)>& task);
+
+	static int defaultThreads(); // nb of hardware threads
+};